@@ -0,0 +1,48 @@
+#include "BarGraph.h"
+
+namespace {
+
+// Columns filled from the left, the bottom row is left for the cursor
+#define BAR_ROWS(bits) {bits, bits, bits, bits, bits, bits, bits, 0}
+
+const uint8_t glyphs[BarGraph::GLYPHS][8] = {
+    BAR_ROWS(0x10), BAR_ROWS(0x18), BAR_ROWS(0x1c), BAR_ROWS(0x1e),
+    BAR_ROWS(0x1f)};
+
+} // namespace
+
+BarGraph::BarGraph(uint8_t pos, uint8_t cells)
+    : _pos(pos), _cells(cells < MAX_CELLS ? cells : MAX_CELLS), _level(0) {}
+
+const uint8_t *BarGraph::glyph(uint8_t columns) { return glyphs[columns - 1]; }
+
+char BarGraph::cell(uint8_t index, uint16_t level) const {
+  uint16_t start = index * LEVELS_PER_CELL;
+  if (level <= start)
+    return ' ';
+  uint16_t columns = level - start;
+  return code(columns < LEVELS_PER_CELL ? columns : LEVELS_PER_CELL);
+}
+
+// Only the cells between the old and the new end of the bar change
+uint8_t BarGraph::set(uint16_t level, uint8_t &pos, char *text) {
+  if (level > levels())
+    level = levels();
+  if (level == _level)
+    return 0;
+  uint8_t first = 0;
+  uint8_t last = _cells - 1;
+  if (_level != UNKNOWN) {
+    uint16_t low = level < _level ? level : _level;
+    uint16_t high = level < _level ? _level : level;
+    first = low / LEVELS_PER_CELL;
+    last = (high - 1) / LEVELS_PER_CELL;
+  }
+  uint8_t count = 0;
+  for (uint8_t i = first; i <= last; i++)
+    text[count++] = cell(i, level);
+  text[count] = 0;
+  pos = _pos + first;
+  _level = level;
+  return count;
+}
@@ -0,0 +1,81 @@
+#ifndef BAR_GRAPH_H
+#define BAR_GRAPH_H
+
+#include "mbed.h"
+
+/** Horizontal bar graph in a run of lcd cells, 5 levels per cell.
+ *
+ * The partly and fully filled cells are custom characters, defined once
+ * with glyph() at start-up. set() remembers the level that is shown and
+ * only returns the cells whose character changes, usually one, two if the
+ * bar crosses a cell border, so the update costs a few bytes on the bus
+ * instead of a whole row. The graph does not talk to the display itself,
+ * the caller prints the cells.
+ *
+ * Example:
+ * @code
+ * BarGraph speed(0x40, 8);
+ * for (uint8_t i = 1; i <= BarGraph::GLYPHS; i++)
+ *   display.glyph(BarGraph::code(i), BarGraph::glyph(i));
+ * uint8_t pos;
+ * char text[BarGraph::MAX_CELLS + 1];
+ * if (speed.set(17, pos, text))
+ *   display.print(pos, text);
+ * @endcode
+ */
+class BarGraph {
+public:
+  /** Levels per cell, one per pixel column */
+  static const uint8_t LEVELS_PER_CELL = 5;
+
+  /** Custom characters used, CGRAM entries 1 to GLYPHS */
+  static const uint8_t GLYPHS = LEVELS_PER_CELL;
+
+  /** Most cells of a graph, one row */
+  static const uint8_t MAX_CELLS = 16;
+
+  /** Create a graph, it starts empty like a cleared display
+   * @param pos First cell like lcd::cursorpos, 0x00.. row 1, 0x40.. row 2
+   * @param cells Number of cells, 1 to MAX_CELLS
+   */
+  BarGraph(uint8_t pos, uint8_t cells);
+
+  /** Character code of a cell with columns pixel columns filled
+   * @param columns 1 to GLYPHS
+   */
+  static uint8_t code(uint8_t columns) { return 8 + columns; }
+
+  /** Pattern of the custom character for code(columns)
+   * @param columns 1 to GLYPHS
+   */
+  static const uint8_t *glyph(uint8_t columns);
+
+  /** Highest level, the graph is full */
+  uint16_t levels() const { return _cells * LEVELS_PER_CELL; }
+
+  /** Change the level and get the cells to print for it
+   * @param level New level, up to levels()
+   * @param pos Set to the position of the first cell to print
+   * @param text Set to the characters of the cells, terminated, must hold
+   *             MAX_CELLS + 1 characters
+   * @return Number of cells in text, 0 if nothing changed
+   */
+  uint8_t set(uint16_t level, uint8_t &pos, char *text);
+
+  /** The display was cleared, the graph shows empty */
+  void reset() { _level = 0; }
+
+  /** The cells were not printed, set() returns all of them next time */
+  void invalidate() { _level = UNKNOWN; }
+
+private:
+  static const uint16_t UNKNOWN = 0xffff;
+
+  char cell(uint8_t index, uint16_t level) const;
+
+  uint8_t _pos;
+  uint8_t _cells;
+  uint16_t _level; // shown
+};
+
+#endif
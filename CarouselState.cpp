@@ -0,0 +1,103 @@
+#include "CarouselState.h"
+
+#include "Trace.h"
+
+namespace {
+
+// Edges of the state machine, a row per from mode, a bit per to mode
+#define TO(mode) (1u << (mode))
+const uint8_t edges[CAROUSEL_MODES] = {
+    // off
+    TO(CAROUSEL_IDLE),
+    // idle
+    TO(CAROUSEL_OFF) | TO(CAROUSEL_RUNNING),
+    // ramping, to itself when the ride changes the speed again
+    TO(CAROUSEL_RAMPING) | TO(CAROUSEL_RUNNING) | TO(CAROUSEL_STOPPING) |
+        TO(CAROUSEL_IDLE),
+    // running
+    TO(CAROUSEL_RUNNING) | TO(CAROUSEL_RAMPING) | TO(CAROUSEL_STOPPING) |
+        TO(CAROUSEL_IDLE),
+    // stopping
+    TO(CAROUSEL_OFF),
+    // emergency
+    0};
+#undef TO
+
+const char *const names[CAROUSEL_MODES] = {"off",     "idle",     "ramping",
+                                           "running", "stopping", "emergency"};
+
+} // namespace
+
+CarouselState::CarouselState() : _word(pack(CAROUSEL_OFF, 0)) {
+  for (int from = 0; from < CAROUSEL_MODES; from++) {
+    for (int to = 0; to < CAROUSEL_MODES; to++)
+      _transitions[from][to] = 0;
+  }
+}
+
+bool CarouselState::allowed(CarouselMode from, CarouselMode to) {
+  return edges[from] & (1u << to);
+}
+
+bool CarouselState::transition(CarouselMode from, CarouselMode to,
+                               uint16_t speed) {
+  return change(from, to, false, speed);
+}
+
+bool CarouselState::transition(CarouselMode from, CarouselMode to) {
+  return change(from, to, true, 0);
+}
+
+// The loop only repeats if the speed changed under us in the same mode,
+// or the store-exclusive was interrupted
+bool CarouselState::change(CarouselMode from, CarouselMode to, bool keepSpeed,
+                           uint16_t speed) {
+  if (!allowed(from, to))
+    return false;
+  uint32_t word = _word.load();
+  do {
+    if (unpack(word).mode != from)
+      return false;
+  } while (!_word.compare_exchange_weak(
+      word, pack(to, keepSpeed ? unpack(word).speed : speed)));
+  _transitions[from][to].fetch_add(1, std::memory_order_relaxed);
+  Trace::log(TRACE_STATE, from << 4 | to,
+             keepSpeed ? unpack(word).speed : speed);
+  return true;
+}
+
+bool CarouselState::emergency() {
+  uint32_t word = _word.load();
+  CarouselMode from;
+  do {
+    from = unpack(word).mode;
+    if (from == CAROUSEL_EMERGENCY)
+      return false;
+  } while (!_word.compare_exchange_weak(word, pack(CAROUSEL_EMERGENCY, 0)));
+  _transitions[from][CAROUSEL_EMERGENCY].fetch_add(1,
+                                                   std::memory_order_relaxed);
+  Trace::log(TRACE_STATE, from << 4 | CAROUSEL_EMERGENCY);
+  return true;
+}
+
+void CarouselState::report(Callback<void(const char *)> print) const {
+  char line[48];
+  Value value = get();
+  snprintf(line, sizeof(line), "state %s, speed %u", name(value.mode),
+           (unsigned)value.speed);
+  print(line);
+  for (int from = 0; from < CAROUSEL_MODES; from++) {
+    for (int to = 0; to < CAROUSEL_MODES; to++) {
+      uint32_t count = transitions((CarouselMode)from, (CarouselMode)to);
+      if (count) {
+        snprintf(line, sizeof(line), "%-9s -> %-9s %8lu",
+                 names[from], names[to], (unsigned long)count);
+        print(line);
+      }
+    }
+  }
+}
+
+const char *CarouselState::name(CarouselMode mode) {
+  return mode < CAROUSEL_MODES ? names[mode] : "?";
+}
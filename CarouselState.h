@@ -0,0 +1,106 @@
+#ifndef CAROUSEL_STATE_H
+#define CAROUSEL_STATE_H
+
+#include "mbed.h"
+
+#include <atomic>
+
+/** Modes of the carousel */
+enum CarouselMode {
+  CAROUSEL_OFF,       ///< switched off
+  CAROUSEL_IDLE,      ///< switched on, waiting for a ride
+  CAROUSEL_RAMPING,   ///< ride running, changing speed
+  CAROUSEL_RUNNING,   ///< ride running at constant speed
+  CAROUSEL_STOPPING,  ///< switched off during a ride, slowing down
+  CAROUSEL_EMERGENCY, ///< emergency stop, final
+  CAROUSEL_MODES
+};
+
+/** State of the carousel in one atomic word, changed by compare-and-swap.
+ *
+ * The word packs the mode and the speed the motor goes to. transition()
+ * only succeeds from the mode the caller saw and only along the edges of
+ * the state machine, so a thread that was preempted by the emergency stop
+ * cannot overwrite it with a stale mode, without any critical section.
+ * Every successful transition is counted.
+ *
+ * Transitions:
+ * - off -> idle -> off: switched on and off
+ * - idle -> running: a ride starts
+ * - running, ramping -> running, ramping: the ride changes the speed
+ * - running, ramping -> idle: the ride ended at the stop speed
+ * - running, ramping -> stopping -> off: switched off during a ride
+ * - any -> emergency
+ *
+ * Example:
+ * @code
+ * CarouselState state;
+ * CarouselState::Value now = state.get();
+ * if (now.mode == CAROUSEL_IDLE &&
+ *     state.transition(CAROUSEL_IDLE, CAROUSEL_RUNNING, 44))
+ *   startRide();
+ * @endcode
+ */
+class CarouselState {
+public:
+  /** Mode and speed read together */
+  struct Value {
+    CarouselMode mode;
+    uint16_t speed; ///< in half steps/s
+  };
+
+  /** Create the state, off at speed 0 */
+  CarouselState();
+
+  /** Read mode and speed at once, from any context */
+  Value get() const { return unpack(_word.load()); }
+
+  /** Change mode and speed if the mode is still from
+   * @param from Mode the caller saw
+   * @param to New mode, may be from to change the speed only
+   * @param speed New speed
+   * @return false if the mode changed meanwhile or the state machine has no
+   *         such transition, nothing is changed then
+   */
+  bool transition(CarouselMode from, CarouselMode to, uint16_t speed);
+
+  /** Change the mode and keep the speed if the mode is still from
+   * @return false like transition() with a speed
+   */
+  bool transition(CarouselMode from, CarouselMode to);
+
+  /** Enter the emergency mode from whatever mode, safe from interrupts
+   * @return false if it was in the emergency mode already
+   */
+  bool emergency();
+
+  /** Number of transitions between two modes so far */
+  uint32_t transitions(CarouselMode from, CarouselMode to) const {
+    return _transitions[from][to].load(std::memory_order_relaxed);
+  }
+
+  /** Send the mode and the counts of all transitions that happened
+   * @param print Called for every line, without line end
+   */
+  void report(Callback<void(const char *)> print) const;
+
+  /** Name of a mode, e.g. "ramping" */
+  static const char *name(CarouselMode mode);
+
+private:
+  static uint32_t pack(CarouselMode mode, uint16_t speed) {
+    return (uint32_t)speed << 16 | mode;
+  }
+  static Value unpack(uint32_t word) {
+    Value value = {(CarouselMode)(word & 0xff), (uint16_t)(word >> 16)};
+    return value;
+  }
+  static bool allowed(CarouselMode from, CarouselMode to);
+  bool change(CarouselMode from, CarouselMode to, bool keepSpeed,
+              uint16_t speed);
+
+  std::atomic<uint32_t> _word;
+  std::atomic<uint32_t> _transitions[CAROUSEL_MODES][CAROUSEL_MODES];
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "Debouncer.h"
+
+#include "Delay.h"
+#include "Profile.h"
+
+PROFILE_SITE(sampleSite, "debounce");
+
+Debouncer::Debouncer(Callback<uint32_t()> sample,
+                     Callback<void(InputEvents)> changed,
+                     std::chrono::microseconds period)
+    : _sample(sample), _changed(changed), _period(period), _wakeCount(0),
+      _sampling(false), _state(0), _count0(0), _count1(0), _holdInputs(0),
+      _heldInputs(0), _samples(0), _wakeCycles(0) {
+  memset(_holdSamples, 0, sizeof(_holdSamples));
+  memset(_holdCount, 0, sizeof(_holdCount));
+}
+
+bool Debouncer::wakeOn(InterruptIn &input) {
+  if (_wakeCount == MAX_WAKE)
+    return false;
+  input.disable_irq();
+  input.rise(callback(this, &Debouncer::wake));
+  input.fall(callback(this, &Debouncer::wake));
+  _wake[_wakeCount++] = &input;
+  return true;
+}
+
+void Debouncer::setHoldTime(uint32_t inputs, std::chrono::milliseconds hold) {
+  uint32_t samples = (hold + _period - 1us) / _period;
+  if (samples > 0xffff)
+    samples = 0xffff;
+  for (int i = 0; i < 32; i++) {
+    if (inputs & 1u << i)
+      _holdSamples[i] = samples;
+  }
+  if (samples)
+    _holdInputs |= inputs;
+  else
+    _holdInputs &= ~inputs;
+}
+
+void Debouncer::start() {
+  _state = _sample();
+  _heldInputs = _state;
+  sleep();
+}
+
+// Edge interrupt of a wake input: sample until the inputs settle
+void Debouncer::wake() {
+  if (_sampling)
+    return;
+  _sampling = true;
+  _wakeCycles = Delay::cycles();
+  for (uint8_t i = 0; i < _wakeCount; i++)
+    _wake[i]->disable_irq();
+  _ticker.attach(callback(this, &Debouncer::sample), _period);
+}
+
+// Timer interrupt: count every input that reads different from its state,
+// an input whose counter wraps after 4 samples toggles. A sample that
+// reads the state again resets the counter.
+void Debouncer::sample() {
+  PROFILE_SCOPE(sampleSite);
+  uint32_t delta = _sample() ^ _state;
+  _samples++;
+  _count1 = (_count1 ^ _count0) & delta;
+  _count0 = ~_count0 & delta;
+  uint32_t toggled = delta & ~(_count0 | _count1);
+  uint32_t state = _state ^ toggled;
+  _state = state;
+
+  InputEvents events = {toggled & state, toggled & ~state, 0};
+  for (uint32_t bits = events.pressed & _holdInputs; bits; bits &= bits - 1)
+    _holdCount[__builtin_ctz(bits)] = 0;
+  _heldInputs &= state;
+  uint32_t holding = state & _holdInputs & ~_heldInputs;
+  for (uint32_t bits = holding; bits; bits &= bits - 1) {
+    int i = __builtin_ctz(bits);
+    if (++_holdCount[i] >= _holdSamples[i])
+      events.held |= 1u << i;
+  }
+  _heldInputs |= events.held;
+
+  if ((events.pressed | events.released | events.held) && _changed)
+    _changed(events);
+  if (delta == 0 && (holding & ~events.held) == 0)
+    sleep();
+}
+
+// Stop sampling and wait for the next edge. An input that changed since
+// the last sample has no edge left to come, so sample on then.
+void Debouncer::sleep() {
+  _ticker.detach();
+  _sampling = false;
+  for (uint8_t i = 0; i < _wakeCount; i++)
+    _wake[i]->enable_irq();
+  if (_sample() != _state)
+    wake();
+}
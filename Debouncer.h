@@ -0,0 +1,96 @@
+#ifndef DEBOUNCER_H
+#define DEBOUNCER_H
+
+#include "mbed.h"
+
+/** Changes of the debounced inputs in one sample, a bit per input */
+struct InputEvents {
+  uint32_t pressed;  ///< went to 1
+  uint32_t released; ///< went to 0
+  uint32_t held;     ///< 1 for the hold time of the input
+};
+
+/** Debounces up to 32 inputs at once from one periodic timer.
+ *
+ * Every sample runs a vertical counter: a two bit counter per input, kept
+ * as two words, so all inputs are debounced with a few bitwise operations.
+ * An input changes once it read the new level in 4 samples in a row.
+ *
+ * To let the controller sleep, the timer only runs while an input is
+ * unsettled. An edge on one of the wake inputs starts it and disables all
+ * wake interrupts, so a bouncing contact costs one interrupt and then the
+ * samples, however dirty it is. Inputs without an interrupt, e.g. mode
+ * switches, are sampled along with the others.
+ *
+ * Example:
+ * @code
+ * PortIn buttons(PortA, 0x42);
+ * uint32_t sample() { return buttons.read(); }
+ * void changed(InputEvents events) { if (events.pressed & 0x02) ... }
+ * Debouncer debouncer(callback(&sample), callback(&changed));
+ * debouncer.wakeOn(InterruptOnOff);
+ * debouncer.start();
+ * @endcode
+ */
+class Debouncer {
+public:
+  /** Most interrupt inputs that can wake the debouncer */
+  static const uint8_t MAX_WAKE = 8;
+
+  /** Create the debouncer
+   * @param sample Reads all inputs into one word, in interrupt context
+   * @param changed Called in interrupt context when inputs changed or were
+   *                held
+   * @param period Time between samples, inputs settle after 4 periods
+   */
+  Debouncer(Callback<uint32_t()> sample, Callback<void(InputEvents)> changed,
+            std::chrono::microseconds period = 5ms);
+
+  /** Wake the debouncer on both edges of an input, before start()
+   * @return false if there are MAX_WAKE inputs already
+   */
+  bool wakeOn(InterruptIn &input);
+
+  /** Report inputs as held once they are 1 for a while
+   * @param inputs Inputs, a bit each
+   * @param hold Time the inputs must be 1, 0 for no hold events
+   */
+  void setHoldTime(uint32_t inputs, std::chrono::milliseconds hold);
+
+  /** Take the current levels as settled and enable the wake inputs */
+  void start();
+
+  /** Debounced levels of the inputs */
+  uint32_t state() const { return _state; }
+
+  /** Cycle count of the edge that started the last samples, the press
+   * of a button that was just reported */
+  uint32_t wakeCycles() const { return _wakeCycles; }
+
+  /** Number of samples taken so far */
+  uint32_t samples() const { return _samples; }
+
+private:
+  void wake();
+  void sample();
+  void sleep();
+
+  Callback<uint32_t()> _sample;
+  Callback<void(InputEvents)> _changed;
+  std::chrono::microseconds _period;
+  InterruptIn *_wake[MAX_WAKE];
+  uint8_t _wakeCount;
+  Ticker _ticker;
+  bool _sampling;
+  uint32_t volatile _state;
+  uint32_t _count0; // low bits of the vertical counters
+  uint32_t _count1; // high bits
+  uint32_t _holdInputs;
+  uint32_t _heldInputs; // held events sent since pressed
+  uint16_t _holdSamples[32];
+  uint16_t _holdCount[32];
+  uint32_t volatile _samples;
+  uint32_t volatile _wakeCycles;
+};
+
+#endif
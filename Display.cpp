@@ -0,0 +1,125 @@
+#include "Display.h"
+
+#include "Profile.h"
+#include "Trace.h"
+#include "hal/us_ticker_api.h"
+
+// The display thread only formats and bit-bangs, printf needs most of it
+#define DISPLAY_STACK_SIZE 2048
+
+PROFILE_SITE(executeSite, "display op");
+PROFILE_SITE(frameSite, "led frame");
+
+Display::Display(lcd &screen, GpioBits leds)
+    : _lcd(screen), _leds(leds),
+      _thread(osPriorityBelowNormal, DISPLAY_STACK_SIZE, NULL, "display"),
+      _load("display"), _mask(0), _frames(NULL), _count(0), _frame(0),
+      _period(0) {}
+
+void Display::start() { _thread.start(callback(this, &Display::run)); }
+
+bool Display::clear() {
+  Op op = {};
+  op.kind = CLEAR;
+  return _ops.post(op);
+}
+
+bool Display::print(uint8_t pos, const char *text) {
+  Op op = {};
+  op.kind = PRINT;
+  op.pos = pos;
+  strncpy(op.text, text, sizeof(op.text) - 1);
+  return _ops.post(op);
+}
+
+bool Display::glyph(uint8_t code, const uint8_t *pattern) {
+  Op op = {};
+  op.kind = GLYPH;
+  op.value = code;
+  op.frames = pattern;
+  return _ops.post(op);
+}
+
+bool Display::leds(uint8_t mask, uint8_t value) {
+  Op op = {};
+  op.kind = LEDS;
+  op.mask = mask;
+  op.value = value;
+  return _ops.post(op);
+}
+
+bool Display::animate(uint8_t mask, const uint8_t *frames, uint8_t count,
+                      std::chrono::milliseconds period) {
+  Op op = {};
+  op.kind = ANIMATE;
+  op.mask = mask;
+  op.frames = frames;
+  op.value = count;
+  op.periodMs = period.count();
+  return _ops.post(op);
+}
+
+void Display::run() {
+  _load.busy();
+  while (true) {
+    Op op;
+    bool received = true;
+    _load.idle();
+    if (_count)
+      received = _ops.receive(op, _next);
+    else
+      _ops.receive(op);
+    _load.busy();
+    if (received) {
+      uint32_t start = us_ticker_read();
+      execute(op);
+      uint32_t us = us_ticker_read() - start;
+      Trace::log(TRACE_LCD, op.kind, us > 0xffff ? 0xffff : us);
+    }
+    if (_count && Kernel::Clock::now() >= _next)
+      nextFrame();
+  }
+}
+
+void Display::execute(const Op &op) {
+  PROFILE_SCOPE(executeSite);
+  switch (op.kind) {
+  case CLEAR:
+    _lcd.clear();
+    break;
+  case PRINT:
+    _lcd.cursorpos(op.pos);
+    _lcd.printf("%s", op.text);
+    break;
+  case GLYPH:
+    _lcd.zeichen(op.value - 8, op.frames);
+    break;
+  case LEDS:
+    setLeds(op.mask, op.value);
+    break;
+  case ANIMATE:
+    setLeds(_mask, 0);
+    _mask = op.mask;
+    _frames = op.frames;
+    _count = op.value;
+    _frame = 0;
+    _period = std::chrono::milliseconds(op.periodMs);
+    _next = Kernel::Clock::now();
+    break;
+  }
+}
+
+void Display::setLeds(uint8_t mask, uint8_t value) {
+  _leds.write(mask, value);
+}
+
+// Show the next frame, frames missed during slow lcd transfers are skipped
+void Display::nextFrame() {
+  PROFILE_SCOPE(frameSite);
+  setLeds(_mask, _frames[_frame]);
+  _frame = (_frame + 1) % _count;
+  _next += _period;
+  Kernel::Clock::time_point now = Kernel::Clock::now();
+  if (_next <= now)
+    _next = now + _period;
+}
@@ -0,0 +1,116 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "mbed.h"
+
+#include "GpioOut.h"
+#include "LCD.h"
+#include "Mailbox.h"
+#include "ThreadLoad.h"
+
+/** Display and LED output that can be posted from interrupts and threads.
+ *
+ * clear(), print(), glyph(), leds() and animate() only copy the operation
+ * into a mailbox, which takes constant time. A low priority thread does the
+ * slow I2C transfers to the lcd and writes the LEDs, so no one else waits
+ * for the display. It owns the lcd and the LED port once started.
+ *
+ * Example:
+ * @code
+ * lcd mylcd;
+ * GpioOut<PortC, 0xff> leds;
+ * Display display(mylcd, leds.bits());
+ * display.start();
+ * display.clear();
+ * display.print(0x40, "Kids");
+ * display.leds(0x03, 0x02);
+ * @endcode
+ */
+class Display {
+public:
+  /** Create the display output
+   * @param screen Display the operations are written to
+   * @param leds LED bits
+   */
+  Display(lcd &screen, GpioBits leds);
+
+  /** Start the display thread, operations posted before are kept */
+  void start();
+
+  /** Post clearing the display
+   * @return false if the mailbox was full
+   */
+  bool clear();
+
+  /** Post writing text
+   * @param pos Position like lcd::cursorpos, 0x00.. row 1, 0x40.. row 2
+   * @param text Text, only the first 16 characters are used
+   * @return false if the mailbox was full
+   */
+  bool print(uint8_t pos, const char *text);
+
+  /** Post defining a custom character, e.g. a cell of a BarGraph
+   * @param code Character code 8..15, like lcd::zeichen
+   * @param pattern 8 rows, must stay valid until the display thread ran
+   * @return false if the mailbox was full
+   */
+  bool glyph(uint8_t code, const uint8_t *pattern);
+
+  /** Post setting LEDs
+   * @param mask LEDs to set
+   * @param value New state of the LEDs in mask
+   * @return false if the mailbox was full
+   */
+  bool leds(uint8_t mask, uint8_t value);
+
+  /** Post an LED animation, it replaces the running one and the LEDs of
+   * that are switched off. The first frame shows at once.
+   * @param mask LEDs of the animation
+   * @param frames Frames, must stay valid while the animation runs
+   * @param count Number of frames, 0 to stop the animation
+   * @param period Time per frame
+   * @return false if the mailbox was full
+   */
+  bool animate(uint8_t mask, const uint8_t *frames, uint8_t count,
+               std::chrono::milliseconds period);
+
+  /** Highest number of operations waiting at once */
+  uint16_t maxDepth() const { return _ops.maxDepth(); }
+
+  /** Number of operations dropped because the mailbox was full */
+  uint32_t dropped() const { return _ops.dropped(); }
+
+private:
+  enum Kind { CLEAR, PRINT, LEDS, ANIMATE, GLYPH };
+
+  struct Op {
+    uint8_t kind;
+    uint8_t pos;           // PRINT
+    uint8_t mask;          // LEDS, ANIMATE
+    uint8_t value;         // LEDS, frame count of ANIMATE, code of GLYPH
+    uint16_t periodMs;     // ANIMATE
+    const uint8_t *frames; // ANIMATE, pattern of GLYPH
+    char text[17];         // PRINT
+  };
+
+  void run();
+  void execute(const Op &op);
+  void setLeds(uint8_t mask, uint8_t value);
+  void nextFrame();
+
+  lcd &_lcd;
+  GpioBits _leds;
+  Mailbox<Op, 16> _ops;
+  Thread _thread;
+  ThreadLoad _load;
+
+  // Running animation, only used by the display thread
+  uint8_t _mask;
+  const uint8_t *_frames;
+  uint8_t _count;
+  uint8_t _frame;
+  Kernel::Clock::duration _period;
+  Kernel::Clock::time_point _next;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "EmergencyStop.h"
+
+#include "Delay.h"
+#include "IrqLock.h"
+#include "Profile.h"
+#include "Trace.h"
+
+// Thread flag of the interrupt to the emergency thread
+#define FLAG_STOPPED 1
+
+// Interrupt priorities, lower numbers preempt higher ones
+#define PRIORITY_EMERGENCY 0
+#define PRIORITY_OTHERS 1
+
+// The handler only posts a message, it needs little stack
+#define EMERGENCY_STACK_SIZE 1024
+
+PROFILE_SITE(isrSite, "emergency");
+
+EmergencyStop::EmergencyStop(PinName pin, Stepper *const *steppers,
+                             uint8_t count, Callback<void()> handler)
+    : _pin(pin), _input(pin), _steppers(steppers), _count(count),
+      _handler(handler),
+      _thread(osPriorityRealtime, EMERGENCY_STACK_SIZE, NULL, "emergency"),
+      _load("emergency"), _triggered(false), _entry(0), _latency(0),
+      _handoff(0) {
+  _input.disable_irq();
+}
+
+void EmergencyStop::arm() {
+  // calibrate now, not in the interrupt
+  Delay::cycles();
+#if defined(TARGET_STM)
+  // all interrupt lines one level down, then the EXTI line of the input up
+  uint32_t lines = ((SCnSCB->ICTR & SCnSCB_ICTR_INTLINESNUM_Msk) + 1) * 32;
+  for (uint32_t irq = 0; irq < lines; irq++)
+    NVIC_SetPriority((IRQn_Type)irq, PRIORITY_OTHERS);
+  uint32_t pin = STM_PIN(_pin);
+  IRQn_Type exti = pin <= 4   ? (IRQn_Type)(EXTI0_IRQn + pin)
+                   : pin <= 9 ? EXTI9_5_IRQn
+                              : EXTI15_10_IRQn;
+  // an enabled line on the same vector would run at the emergency priority
+  // and delay the stop
+  uint32_t shared = pin <= 4 ? 0 : pin <= 9 ? 0x03e0 : 0xfc00;
+  MBED_ASSERT((EXTI->IMR & shared & ~(1u << pin)) == 0);
+  NVIC_SetPriority(exti, PRIORITY_EMERGENCY);
+  // our critical sections no longer mask the emergency stop
+  IrqLock::setCeiling(PRIORITY_OTHERS);
+#endif
+  _thread.start(callback(this, &EmergencyStop::run));
+  _input.mode(PullDown);
+  _input.rise(callback(this, &EmergencyStop::isr));
+  _input.enable_irq();
+}
+
+uint32_t EmergencyStop::cyclesToNs(uint32_t cycles) {
+  return (uint64_t)cycles * 1000 / Delay::nsToCycles(1000);
+}
+
+// Highest priority interrupt: cut the coils first, everything else later
+void EmergencyStop::isr() {
+  uint32_t entry = Delay::cycles();
+  for (uint8_t i = 0; i < _count; i++)
+    _steppers[i]->freeze();
+  uint32_t off = Delay::cycles();
+  if (_triggered)
+    return;
+  _triggered = true;
+  _entry = entry;
+  _latency = off - entry;
+  Trace::log(TRACE_EMERGENCY, 0, _latency > 0xffff ? 0xffff : _latency);
+  _input.disable_irq();
+  _thread.flags_set(FLAG_STOPPED);
+  // from the entry taken anyway, a scope would delay cutting the coils
+  PROFILE_ADD(isrSite, Delay::cycles() - entry);
+}
+
+void EmergencyStop::run() {
+  ThisThread::flags_wait_any(FLAG_STOPPED);
+  _load.busy();
+  _handoff = Delay::cycles() - _entry;
+  // the step interrupt may have stored a phase just before it saw the
+  // stop, stop() cuts the coils once more
+  for (uint8_t i = 0; i < _count; i++)
+    _steppers[i]->stop();
+  if (_handler)
+    _handler();
+  _load.idle();
+}
@@ -0,0 +1,73 @@
+#ifndef EMERGENCY_STOP_H
+#define EMERGENCY_STOP_H
+
+#include "mbed.h"
+
+#include "Stepper.h"
+#include "ThreadLoad.h"
+
+/** Emergency stop input that cuts the coils of all motors in its interrupt.
+ *
+ * arm() gives the input the highest interrupt priority and moves all other
+ * interrupts one level down, so the stop preempts the step, ticker and
+ * button interrupts. The interrupt only freezes the steppers, which write
+ * their coil ports, and then wakes a thread that runs the handler, e.g. to
+ * tell the control thread. The time from entering the interrupt to the last
+ * coil write is measured with the cycle counter.
+ *
+ * The input needs an EXTI vector of its own: EXTI0 to EXTI4, or EXTI9_5 or
+ * EXTI15_10 with no other interrupt input on lines 5 to 9 or 10 to 15.
+ * arm() asserts this for the inputs enabled before it.
+ *
+ * Example:
+ * @code
+ * void showStop() { ... }
+ * Stepper *const motors[] = {&stepper};
+ * EmergencyStop emergencyStop(PA_10, motors, 1, callback(&showStop));
+ * int main() { emergencyStop.arm(); ... }
+ * @endcode
+ */
+class EmergencyStop {
+public:
+  /** Create the emergency stop
+   * @param pin Input, stops on the rising edge
+   * @param steppers Step generators to freeze, in this order
+   * @param count Number of steppers
+   * @param handler Runs once in the emergency thread after the stop
+   */
+  EmergencyStop(PinName pin, Stepper *const *steppers, uint8_t count,
+                Callback<void()> handler);
+
+  /** Set the interrupt priorities, start the thread and enable the input,
+   * after the other interrupt inputs are enabled */
+  void arm();
+
+  /** Whether the emergency stop was triggered */
+  bool triggered() const { return _triggered; }
+
+  /** Time from entering the interrupt to writing the last coil port in
+   * ns */
+  uint32_t latencyNs() const { return cyclesToNs(_latency); }
+
+  /** Time from the interrupt to the handler running in ns */
+  uint32_t handoffNs() const { return cyclesToNs(_handoff); }
+
+private:
+  static uint32_t cyclesToNs(uint32_t cycles);
+  void isr();
+  void run();
+
+  PinName _pin;
+  InterruptIn _input;
+  Stepper *const *_steppers;
+  uint8_t _count;
+  Callback<void()> _handler;
+  Thread _thread;
+  ThreadLoad _load;
+  bool volatile _triggered;
+  uint32_t volatile _entry;
+  uint32_t volatile _latency;
+  uint32_t _handoff;
+};
+
+#endif
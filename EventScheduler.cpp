@@ -0,0 +1,95 @@
+#include "EventScheduler.h"
+
+#include "IrqLock.h"
+#include "Profile.h"
+
+PROFILE_SITE(fireSite, "scheduled events");
+
+EventScheduler::EventScheduler() : _head(NULL), _count(0) {}
+
+void EventScheduler::post(Event &event, Callback<void()> func,
+                          std::chrono::microseconds delay) {
+  postAt(event, func, TickerDataClock::now() + delay);
+}
+
+void EventScheduler::postAt(Event &event, Callback<void()> func,
+                            time_point time) {
+  IrqLock lock;
+  Event *first = _head;
+  if (event._pending)
+    unlink(event);
+  event._time = time;
+  event._func = func;
+  // Behind all events of the same time, so they run in posting order
+  Event *prev = NULL;
+  Event *next = _head;
+  while (next && next->_time <= time) {
+    prev = next;
+    next = next->_next;
+  }
+  event._prev = prev;
+  event._next = next;
+  if (next)
+    next->_prev = &event;
+  if (prev)
+    prev->_next = &event;
+  else
+    _head = &event;
+  event._pending = true;
+  _count++;
+  if (_head != first || _head == &event)
+    arm();
+}
+
+void EventScheduler::cancel(Event &event) {
+  IrqLock lock;
+  if (!event._pending)
+    return;
+  bool first = _head == &event;
+  unlink(event);
+  if (first)
+    arm();
+}
+
+void EventScheduler::unlink(Event &event) {
+  if (event._prev)
+    event._prev->_next = event._next;
+  else
+    _head = event._next;
+  if (event._next)
+    event._next->_prev = event._prev;
+  event._prev = NULL;
+  event._next = NULL;
+  event._pending = false;
+  _count--;
+}
+
+// Arm the timer for the earliest event, called with interrupts masked
+void EventScheduler::arm() {
+  if (_head)
+    _timeout.attach_absolute(callback(this, &EventScheduler::fire),
+                             _head->_time);
+  else
+    _timeout.detach();
+}
+
+// Runs in interrupt context: run every event that is due. The lock is only
+// held to take an event off the list, the callback runs without it.
+void EventScheduler::fire() {
+  PROFILE_SCOPE(fireSite);
+  while (true) {
+    Callback<void()> func;
+    {
+      IrqLock lock;
+      if (!_head || _head->_time > TickerDataClock::now()) {
+        arm();
+        return;
+      }
+      Event &event = *_head;
+      func = event._func;
+      unlink(event);
+    }
+    if (func)
+      func();
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include "mbed.h"
+
+/** Runs any number of timed callbacks from one Timeout.
+ *
+ * Pending events are kept in a list sorted by time, and only the earliest
+ * one is armed in the timer driver. Events are owned by the caller, so the
+ * scheduler needs no memory of its own. Inserting walks the list, cancelling
+ * unlinks the event in constant time.
+ *
+ * The callbacks run in interrupt context and may post or cancel events.
+ * post() and cancel() can be called from threads and interrupts.
+ *
+ * Example:
+ * @code
+ * EventScheduler scheduler;
+ * EventScheduler::Event slowDown;
+ * scheduler.post(slowDown, &changeSpeedSlow, 30s);
+ * scheduler.cancel(slowDown);
+ * @endcode
+ */
+class EventScheduler {
+public:
+  typedef TickerDataClock::time_point time_point;
+
+  /** Storage for one pending callback */
+  class Event {
+  public:
+    Event() : _prev(NULL), _next(NULL), _pending(false) {}
+
+    /** Whether the event is waiting to run */
+    bool pending() const { return _pending; }
+
+    /** Time the event is or was last posted for */
+    time_point time() const { return _time; }
+
+  private:
+    friend class EventScheduler;
+    Event(const Event &);
+    Event &operator=(const Event &);
+
+    time_point _time;
+    Callback<void()> _func;
+    Event *_prev;
+    Event *_next;
+    bool volatile _pending;
+  };
+
+  EventScheduler();
+
+  /** Run a callback after a delay, an already pending event is moved
+   * @param event Event to use, must stay valid while pending
+   * @param func Callback, runs in interrupt context
+   * @param delay Time from now
+   */
+  void post(Event &event, Callback<void()> func,
+            std::chrono::microseconds delay);
+
+  /** Run a callback at an absolute time, an already pending event is moved
+   * @param event Event to use, must stay valid while pending
+   * @param func Callback, runs in interrupt context
+   * @param time Time to run at, runs immediately if in the past
+   */
+  void postAt(Event &event, Callback<void()> func, time_point time);
+
+  /** Remove an event if it is pending
+   * @param event Event to remove
+   */
+  void cancel(Event &event);
+
+  /** Number of pending events */
+  uint16_t pending() const { return _count; }
+
+private:
+  void unlink(Event &event);
+  void arm();
+  void fire();
+
+  Timeout _timeout;
+  Event *_head;
+  uint16_t volatile _count;
+};
+
+#endif
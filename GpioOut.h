@@ -0,0 +1,125 @@
+#ifndef GPIO_OUT_H
+#define GPIO_OUT_H
+
+#include "mbed.h"
+
+/** Output bits of a GPIO port, written through the bit set/reset register.
+ *
+ * A write is a single store to BSRR: the set half switches bits on, the
+ * reset half switches bits off, all other bits of the port keep their
+ * level. Unlike the read-modify-write of PortOut on ODR, writes to
+ * different bits of one port from an interrupt and a thread cannot undo
+ * each other.
+ *
+ * GpioBits is the handle a driver keeps, GpioOut configures the pins and
+ * builds it from the port and mask known at compile time.
+ *
+ * Example:
+ * @code
+ * GpioOut<PortC, 0xff> leds;
+ * leds.set(0x01);        // BSRR = 0x00000001
+ * leds.write(0x0f);      // BSRR = 0x00f0000f
+ * GpioBits bits = leds.bits();
+ * bits.clear(0x01);
+ * @endcode
+ */
+struct GpioBits {
+  GPIO_TypeDef *gpio;
+  uint32_t mask;
+
+  /** Word for BSRR that sets the bits of mask to value */
+  uint32_t setReset(uint32_t value) const {
+    return (value & mask) | (~value & mask) << 16;
+  }
+
+  /** Store a word built by setReset(), e.g. a precomputed table entry */
+  void store(uint32_t setResetWord) const { gpio->BSRR = setResetWord; }
+
+  /** Set all bits of the mask to value */
+  void write(uint32_t value) const { gpio->BSRR = setReset(value); }
+
+  /** Set some bits of the mask to value, leave the others
+   * @param bits Bits to change
+   * @param value New level of the bits
+   */
+  void write(uint32_t bits, uint32_t value) const {
+    gpio->BSRR = (value & bits & mask) | (~value & bits & mask) << 16;
+  }
+
+  /** Switch bits on */
+  void set(uint32_t bits) const { gpio->BSRR = bits & mask; }
+
+  /** Switch bits off */
+  void clear(uint32_t bits) const { gpio->BSRR = (bits & mask) << 16; }
+
+  /** Output level of the bits of the mask */
+  uint32_t read() const { return gpio->ODR & mask; }
+};
+
+/** GPIO registers of a port, NULL if the device has no such port */
+inline GPIO_TypeDef *gpioRegisters(PortName port) {
+  switch (port) {
+  case PortA:
+    return GPIOA;
+  case PortB:
+    return GPIOB;
+  case PortC:
+    return GPIOC;
+#if defined(GPIOD)
+  case PortD:
+    return GPIOD;
+#endif
+#if defined(GPIOH)
+  case PortH:
+    return GPIOH;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+/** Output bits of a port known at compile time
+ * @tparam Port Port of the bits
+ * @tparam Mask Bits of the port, the pins are configured as outputs
+ */
+template <PortName Port, uint32_t Mask> class GpioOut {
+  static_assert(Mask != 0 && Mask <= 0xffff, "a port has 16 bits");
+
+public:
+  /** Configure the pins of the mask as outputs */
+  GpioOut() {
+    port_t port;
+    port_init(&port, Port, Mask, PIN_OUTPUT);
+  }
+
+  /** Handle to pass to drivers */
+  GpioBits bits() const { return GpioBits{gpioRegisters(Port), Mask}; }
+
+  /** Word for BSRR that sets the bits of Mask to value */
+  static constexpr uint32_t setReset(uint32_t value) {
+    return (value & Mask) | (~value & Mask) << 16;
+  }
+
+  /** Set all bits of the mask to value */
+  void write(uint32_t value) { gpioRegisters(Port)->BSRR = setReset(value); }
+
+  /** Switch bits on */
+  void set(uint32_t bits) { gpioRegisters(Port)->BSRR = bits & Mask; }
+
+  /** Switch bits off */
+  void clear(uint32_t bits) {
+    gpioRegisters(Port)->BSRR = (bits & Mask) << 16;
+  }
+
+  /** Output level of the bits of the mask */
+  uint32_t read() const { return gpioRegisters(Port)->ODR & Mask; }
+
+  GpioOut &operator=(uint32_t value) {
+    write(value);
+    return *this;
+  }
+
+  operator uint32_t() const { return read(); }
+};
+
+#endif
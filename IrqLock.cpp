@@ -0,0 +1,62 @@
+#include "IrqLock.h"
+
+#include "Delay.h"
+
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+#define IRQ_LOCK_HAS_BASEPRI 1
+#else
+#define IRQ_LOCK_HAS_BASEPRI 0
+#endif
+
+uint8_t IrqLock::_basepri = 0;
+uint8_t IrqLock::_depth = 0;
+uint32_t IrqLock::_start = 0;
+uint32_t volatile IrqLock::_longest = 0;
+
+IrqLock::IrqLock() : _basepriUsed(IRQ_LOCK_HAS_BASEPRI && _basepri != 0) {
+  if (_basepriUsed) {
+    _saved = __get_BASEPRI();
+    __set_BASEPRI_MAX(_basepri);
+  } else {
+    _saved = __get_PRIMASK();
+    __disable_irq();
+  }
+  if (_depth++ == 0)
+    _start = Delay::cycles();
+}
+
+IrqLock::~IrqLock() {
+  if (--_depth == 0) {
+    uint32_t cycles = Delay::cycles() - _start;
+    if (cycles > _longest)
+      _longest = cycles;
+  }
+  if (_basepriUsed)
+    __set_BASEPRI(_saved);
+  else
+    __set_PRIMASK(_saved);
+}
+
+void IrqLock::setCeiling(uint8_t priority) {
+#if IRQ_LOCK_HAS_BASEPRI
+  _basepri = priority << (8 - __NVIC_PRIO_BITS);
+#endif
+}
+
+bool IrqLock::masksCaller() {
+#if IRQ_LOCK_HAS_BASEPRI
+  uint32_t exception = __get_IPSR();
+  if (exception == 0 || _basepri == 0)
+    return true;
+  uint32_t priority = NVIC_GetPriority((IRQn_Type)((int32_t)exception - 16));
+  return priority << (8 - __NVIC_PRIO_BITS) >= _basepri;
+#else
+  return true;
+#endif
+}
+
+uint32_t IrqLock::longestNs() {
+  // cycles per us from the calibration of Delay
+  uint32_t perUs = Delay::nsToCycles(1000);
+  return (uint64_t)_longest * 1000 / perUs;
+}
@@ -0,0 +1,63 @@
+#ifndef IRQ_LOCK_H
+#define IRQ_LOCK_H
+
+#include "mbed.h"
+
+/** Masks interrupts for the lifetime of the object and measures how long.
+ *
+ * After setCeiling(), only interrupts of that priority and below are masked
+ * through BASEPRI, so interrupts of a higher priority (the emergency stop)
+ * stay enabled. Before, or on a core without BASEPRI, all interrupts are
+ * masked through PRIMASK.
+ *
+ * The longest window, from the outermost lock to its release, is kept so
+ * the worst case interrupt latency we add can be read at run time.
+ *
+ * Example:
+ * @code
+ * {
+ *   IrqLock lock;
+ *   // shared state
+ * }
+ * printf("%lu ns\n", IrqLock::longestNs());
+ * @endcode
+ */
+class IrqLock {
+public:
+  IrqLock();
+  ~IrqLock();
+
+  /** Mask only interrupts from an NVIC priority on, call once all
+   * interrupts that have to be masked have this or a lower priority
+   * @param priority NVIC priority, 0 to mask all interrupts again
+   */
+  static void setCeiling(uint8_t priority);
+
+  /** Whether a lock keeps out the caller's interrupt and all interrupts
+   * that could preempt it, always true in a thread. False in an interrupt
+   * above the ceiling, e.g. the emergency stop.
+   */
+  static bool masksCaller();
+
+  /** Longest masked window since start-up or resetLongest() in ns */
+  static uint32_t longestNs();
+
+  /** Longest masked window in core cycles */
+  static uint32_t longestCycles() { return _longest; }
+
+  /** Start a new measurement */
+  static void resetLongest() { _longest = 0; }
+
+private:
+  IrqLock(const IrqLock &);
+  IrqLock &operator=(const IrqLock &);
+
+  bool _basepriUsed;
+  uint32_t _saved; // PRIMASK or BASEPRI before the lock
+  static uint8_t _basepri;
+  static uint8_t _depth;
+  static uint32_t _start;
+  static uint32_t volatile _longest;
+};
+
+#endif
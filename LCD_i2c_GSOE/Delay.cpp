@@ -0,0 +1,63 @@
+/*
+ * Busy-wait delays for the LCD and SoftwareI2C drivers, calibrated against
+ * the DWT cycle counter instead of assuming a core clock.
+ */
+
+#include "Delay.h"
+#include "hal/us_ticker_api.h"
+
+// Measuring for 1 ms keeps the error of the us ticker below 0.1 %
+#define CALIBRATION_US 1000
+
+uint32_t Delay::_cycles_per_us = 0;
+
+void Delay::calibrate() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // start on a tick edge
+    uint32_t start = us_ticker_read();
+    while (us_ticker_read() == start);
+    start = us_ticker_read();
+    uint32_t start_cycles = DWT->CYCCNT;
+
+    uint32_t elapsed;
+    do {
+        elapsed = us_ticker_read() - start;
+    } while (elapsed < CALIBRATION_US);
+    uint32_t cycles = DWT->CYCCNT - start_cycles;
+
+    _cycles_per_us = (cycles + elapsed / 2) / elapsed;
+    if (_cycles_per_us == 0) _cycles_per_us = 1;
+}
+
+uint32_t Delay::cycles() {
+    if (_cycles_per_us == 0) calibrate();
+    return DWT->CYCCNT;
+}
+
+uint32_t Delay::nsToCycles(uint32_t ns) {
+    if (_cycles_per_us == 0) calibrate();
+    return ((uint64_t)ns * _cycles_per_us + 999) / 1000;
+}
+
+uint32_t Delay::until(uint32_t deadline) {
+    uint32_t now = cycles();
+    // signed difference, the counter wraps every few minutes
+    if ((int32_t)(now - deadline) >= 0) return now;
+    while ((int32_t)(DWT->CYCCNT - deadline) < 0);
+    return deadline;
+}
+
+void Delay::ns(uint32_t ns) {
+    until(cycles() + nsToCycles(ns));
+}
+
+void Delay::us(uint32_t us) {
+    // in steps of 1 ms, so long waits do not overflow nsToCycles
+    while (us > 1000) {
+        ns(1000000);
+        us -= 1000;
+    }
+    ns(us * 1000);
+}
@@ -0,0 +1,48 @@
+/*
+ * Busy-wait delays for the LCD and SoftwareI2C drivers, calibrated against
+ * the DWT cycle counter instead of assuming a core clock.
+ */
+
+#ifndef _DELAY_H_
+#define _DELAY_H_
+
+#include "mbed.h"
+
+/**
+  * @brief Delay class
+  *
+  * The cycle counter is measured against the us ticker on first use, so the
+  * delays stay right whatever SystemCoreClock and the PLL settings are.
+  * Interrupts can only make a delay longer.
+  */
+class Delay {
+public:
+    /** Measure the core cycles per us, call again after changing the clock */
+    static void calibrate();
+
+    /** Wait at least ns nanoseconds */
+    static void ns(uint32_t ns);
+
+    /** Wait at least us microseconds */
+    static void us(uint32_t us);
+
+    /** Current value of the cycle counter */
+    static uint32_t cycles();
+
+    /** Cycles for a duration, rounded up
+     * @param ns Duration in ns
+     */
+    static uint32_t nsToCycles(uint32_t ns);
+
+    /** Wait until the cycle counter has passed a deadline
+     * @param deadline Cycle count, e.g. the return value of the last call
+     *                 plus nsToCycles()
+     * @return The deadline, or the current count if it had already passed
+     */
+    static uint32_t until(uint32_t deadline);
+
+private:
+    static uint32_t _cycles_per_us;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * I2C bus for the lcd driver on the I2C peripheral of the microcontroller
+ */
+
+#include "HardwareI2C.h"
+
+#if DEVICE_I2C_ASYNCH
+
+// Event flag set at the end of an asynchronous transfer
+#define FLAG_DONE 1
+
+HardwareI2C::HardwareI2C(PinName sda, PinName scl) : _i2c(sda, scl), _busy(false), _ok(true) {
+    setFrequency(100000);
+}
+
+/**
+ * @brief Read 1 or more bytes from the I2C slave
+ * @param device_address The address of the device to read from
+ * @param data An allocated array to read the data into
+ * @param data_bytes Number of bytes to read
+ */
+void HardwareI2C::read(uint8_t device_address, uint8_t* data, uint8_t data_bytes) {
+    if (data == 0 || data_bytes == 0) return;
+    wait();
+    _i2c.read(device_address | 0x01, (char*)data, data_bytes);
+}
+
+/**
+ * @brief Write 1 or more bytes to the I2C slave
+ * @param device_address The address of the device to write to
+ * @param data An array to write the data from
+ * @param data_bytes Number of bytes to write from array
+ */
+void HardwareI2C::write(uint8_t device_address, uint8_t* data, uint8_t data_bytes) {
+    if (data == 0 || data_bytes == 0) return;
+    wait();
+    _i2c.write(device_address & 0xFE, (const char*)data, data_bytes);
+}
+
+/**
+ * @brief Write 1 byte to the I2C slave
+ * @param device_address The address of the device to write to
+ * @param byte The data to write
+ */
+void HardwareI2C::write(uint8_t device_address, uint8_t byte) {
+    write(device_address, &byte, 1);
+}
+
+/**
+ * @brief Write 1 or more bytes to the I2C slave without waiting
+ * @param device_address The address of the device to write to
+ * @param data An array to write the data from, valid until done is called
+ * @param data_bytes Number of bytes to write from array
+ * @param done Called in interrupt context with whether the slave acknowledged
+ * @return false if another transfer is running
+ */
+bool HardwareI2C::write(uint8_t device_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done) {
+    if (data == 0 || data_bytes == 0 || _busy) return false;
+    _done = done;
+    _done_flag.clear(FLAG_DONE);
+    _ok = true;
+    _busy = true;
+    if (_i2c.transfer(device_address & 0xFE, (const char*)data, data_bytes, NULL, 0,
+                      callback(this, &HardwareI2C::transferred), I2C_EVENT_ALL) != 0) {
+        _busy = false;
+        _ok = false;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Sleeps until the asynchronous transfer has finished
+ * @return Whether the slave acknowledged the last transfer
+ */
+bool HardwareI2C::wait() {
+    if (_busy) _done_flag.wait_any(FLAG_DONE);
+    return _ok;
+}
+
+/**
+ * @brief Sets the SCL frequency
+ * @param frequency SCL frequency in Hz, 100 kHz or 400 kHz on the L152
+ */
+void HardwareI2C::setFrequency(uint32_t frequency) {
+    _frequency = frequency;
+    _i2c.frequency(frequency);
+}
+
+void HardwareI2C::transferred(int event) {
+    _ok = !(event & (I2C_EVENT_ERROR | I2C_EVENT_ERROR_NO_SLAVE | I2C_EVENT_TRANSFER_EARLY_NACK));
+    _busy = false;
+    _done_flag.set(FLAG_DONE);
+    if (_done) _done(_ok);
+}
+
+#endif
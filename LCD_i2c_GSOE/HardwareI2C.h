@@ -0,0 +1,69 @@
+/*
+ * I2C bus for the lcd driver on the I2C peripheral of the microcontroller
+ */
+
+#ifndef _HARDWARE_I2C_H_
+#define _HARDWARE_I2C_H_
+
+#include "mbed.h"
+
+#if DEVICE_I2C_ASYNCH
+
+/**
+  * @brief HardwareI2C class
+  *
+  * Same interface as SoftwareI2C on top of mbed::I2C. Asynchronous writes
+  * use I2C::transfer, the peripheral moves the bytes in its interrupt and the
+  * CPU is free during the transfer. Only works on the I2C pins of the
+  * peripheral, e.g. PB_9 (SDA) and PB_8 (SCL) for I2C1 on the NUCLEO-L152RE.
+  */
+class HardwareI2C {
+public:
+    HardwareI2C(PinName sda, PinName scl);
+
+    void read(uint8_t device_address, uint8_t* data, uint8_t data_bytes);
+    void write(uint8_t device_address, uint8_t* data, uint8_t data_bytes);
+    void write(uint8_t device_address, uint8_t byte);
+
+    /** Start a write without waiting for it
+     * @param done Called in interrupt context at the end with whether the
+     *        slave acknowledged, may be NULL. data must stay valid until then.
+     * @return false if another transfer is still running
+     */
+    bool write(uint8_t device_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done);
+
+    /** Whether an asynchronous transfer is running */
+    bool busy() const {
+        return _busy;
+    }
+
+    /** Sleep until the asynchronous transfer has finished, thread context only
+     * @return Whether the slave acknowledged the last transfer
+     */
+    bool wait();
+
+    /** Set the SCL frequency, for synchronous and asynchronous transfers */
+    void setFrequency(uint32_t frequency);
+
+    uint32_t frequency() const {
+        return _frequency;
+    }
+
+    uint32_t asyncFrequency() const {
+        return _frequency;
+    }
+
+private:
+    void transferred(int event);
+
+    I2C _i2c;
+    EventFlags _done_flag;
+    Callback<void(bool)> _done;
+    uint32_t _frequency;
+    bool volatile _busy;
+    bool volatile _ok;
+};
+
+#endif
+
+#endif
@@ -1,34 +1,51 @@
 #include "LCD.h"
+#include "Profile.h"
 
-lcd::lcd(void)
+//HD44780-Zeiten bei 2,7 V laut Datenblatt
+#define LCD_E_PULS_NS   450     //PWEH
+#define LCD_ZYKLUS_NS   1000    //tcycE
+#define LCD_BEFEHL_US   37
+#define LCD_DATEN_US    41      //37 us + tADD
+#define LCD_CLEAR_US    1520
+
+PROFILE_SITE(sendeByteSite,"lcd sendeByte");
+PROFILE_SITE(flushSite,"lcd flush");
+
+template <class Bus>
+lcd_t<Bus>::lcd_t(PinName sda,PinName scl)
     {
-        i2c=new SoftwareI2C(PA_12,PA_11);
+        i2c=new Bus(sda,scl);
         //po=new PortOut(PortC,0xFF);
         //t=new DigitalIn(PA_1,PullDown);
         init();
         
     };
     
-void lcd::clear(void)
+template <class Bus>
+void lcd_t<Bus>::clear(void)
 {
-
-    sendeByte(0x01,0,0);
+    //flush waehlt zwischen dem 0x01-Befehl und dem Ueberschreiben der
+    //Zeichen, die nicht schon leer sind
+    memset(schatten,' ',sizeof(schatten));
     cursorpos(0);
-    //sleep_for(20);
-
+    flush();
 };
 
-void lcd::locate(int column, int row)
+template <class Bus>
+void lcd_t<Bus>::locate(int column, int row)
 {
     cursorpos(column+row*0x40);
 }
 
-void lcd::putc(int c)
+template <class Bus>
+void lcd_t<Bus>::putc(int c)
 {
-    sendeByte(c,0,1);   
+    schreibe(c);
+    flush();
 }
 
-void lcd::cls()
+template <class Bus>
+void lcd_t<Bus>::cls()
 {
     clear();
 }
@@ -43,60 +60,279 @@ void lcd::warte(void)
     wait_ms(20);
 };*/
 
-void lcd::warte()
-{   
-    asm("push   {R0,R1}          \n"
-        "ldr R0,=32000000/5/1000     \n"
-        "mov R1,#1              \n"
-        "1:                     \n"  
-        "subs  R0,R1            \n"
-        "bne   1b               \n"
-        "pop   {R0,R1}          \n"
-        );    
+//Ausfuehrungszeit des Befehls b bzw. des Zeichens (rs=1) in us
+static uint16_t ausfuehrung(char b,uint8_t rs)
+{
+    if (rs&0x01) return LCD_DATEN_US;
+    if ((uint8_t)b<0x04) return LCD_CLEAR_US;   //clear, home
+    return LCD_BEFEHL_US;
 }
-void lcd::sendeByte(char b,uint8_t rw, uint8_t rs )
+
+//Dauer einer Busy-Flag-Abfrage in Bittakten: zwei Schreib- und eine
+//Leseuebertragung mit START, Adresse und STOP
+#define LCD_ABFRAGE_TAKTE 85
+
+//Dauer einer Busy-Flag-Abfrage in us
+template <class Bus>
+uint32_t lcd_t<Bus>::abfrageUs(void)
 {
-    
+    return LCD_ABFRAGE_TAKTE*1000000u/i2c->frequency();
+}
+
+//Wartet nach einem Befehl. Das Busy-Flag wird gelesen, wenn eine Abfrage
+//kuerzer ist als die Ausfuehrungszeit laut Datenblatt: dann endet das
+//Warten hoechstens eine Abfrage nach dem Befehl, und meist frueher als die
+//feste Zeit, weil die Controller schneller sind als der schlechteste Fall.
+//Bei 100 kHz sind das clear und home, Zeichen und kurze Befehle sind
+//schneller ausgefuehrt als eine Abfrage.
+template <class Bus>
+void lcd_t<Bus>::warte(char b,uint8_t rs)
+{
+    uint16_t us=ausfuehrung(b,rs);
+    if (lesen && us>abfrageUs())
+    {
+        if (warteBereit(us)) return;
+    }
+    Delay::us(us);
+}
+
+//Fragt das Busy-Flag ab, bis der Controller bereit ist. Liefert false und
+//schaltet auf feste Wartezeiten um, wenn das Lesen nicht funktioniert oder
+//der Controller nach der zehnfachen Zeit noch beschaeftigt ist.
+template <class Bus>
+bool lcd_t<Bus>::warteBereit(uint16_t us)
+{
+    uint32_t start=Delay::cycles();
+    uint32_t grenze=Delay::nsToCycles(us*10000u);
+    do
+    {
+        int8_t s=status();
+        if (s<0) break;
+        if (!(s&0x08)) return true;
+    } while (Delay::cycles()-start<grenze);
+    lesen=false;
+    return false;
+}
+
+//Liest das obere Nibble des Statusregisters: Busy-Flag (Bit 3) und Bits
+//6..4 des Adresszaehlers. Das untere Nibble wird nur ausgetaktet.
+//-1, wenn die Antwort nicht von einem HD44780 stammen kann.
+template <class Bus>
+int8_t lcd_t<Bus>::status(void)
+{
+    //D7..D4 auf 1, damit der PCF8574 sie als Eingang liest
+    uint8_t aus=0xF0+0x08+0x02;
+    uint8_t ein=aus+0x04;
+    uint8_t hoch[2]={aus,ein};
+    uint8_t rest[3]={aus,ein,aus};
+    uint8_t antwort;
+    i2c->write(Adresse,hoch,2);
+    i2c->read(Adresse,&antwort,1);
+    i2c->write(Adresse,rest,3);
+    //zweizeilig ist der Adresszaehler 0x00..0x27 oder 0x40..0x67, nach
+    //zeichen zeigt er ins CGRAM, wo 0x00..0x3F alle vorkommen
+    if (!cgram && ((antwort&0x70)==0x30 || (antwort&0x70)==0x70)) return -1;
+    return antwort>>4;
+}
+
+template <class Bus>
+void lcd_t<Bus>::busyflag(bool an)
+{
+    lesen=an;
+}
+
+template <class Bus>
+bool lcd_t<Bus>::busyflag(void)
+{
+    return lesen;
+}
+template <class Bus>
+void lcd_t<Bus>::sendeByte(char b,uint8_t rw, uint8_t rs )
+{
+    PROFILE_SCOPE(sendeByteSite);
+    //eine PCF8574-Uebertragung dauert schon laenger als die E-Zeiten, die
+    //Wartezeiten gelten auch fuer schnellere Busse
     wert=(b&0xF0)+0x08+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
     wert=(b&0xF0)+0xC+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
+    Delay::ns(LCD_E_PULS_NS);
     wert=(b&0xF0)+0x8+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
+    Delay::ns(LCD_ZYKLUS_NS-LCD_E_PULS_NS);
     wert=((b&0xF)<<4)+0x8+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
     wert=((b&0xF)<<4)+0xC+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
+    Delay::ns(LCD_E_PULS_NS);
     wert=((b&0xF)<<4)+0x8+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
+    warte(b,rs);
 }
 
-void lcd::sendeNippel(char b,uint8_t rw, uint8_t rs )
+template <class Bus>
+void lcd_t<Bus>::sendeNippel(char b,uint8_t rw, uint8_t rs )
 {
     wert=((b&0xF)<<4)+0x0+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
     wert=((b&0xF)<<4)+0x4+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
+    Delay::ns(LCD_E_PULS_NS);
     wert=((b&0xF)<<4)+0x0+((rw&0x01)<<1)+(rs&0x01);
     i2c->write(Adresse,wert);
-    warte();
+    warte(b<<4,rs);
+}
+template <class Bus>
+void lcd_t<Bus>::cursorpos(uint8_t pos)
+{
+    zeile=(pos&0x40)?1:0;
+    spalte=pos&0x3F;
+}
+
+template <class Bus>
+void lcd_t<Bus>::schreibe(char c)
+{
+    //Zeichen rechts vom Display sind nicht sichtbar
+    if (spalte<16) schatten[zeile][spalte]=c;
+    if (spalte<0x3F) spalte++;
 }
-void lcd::cursorpos(uint8_t pos)
+
+template <class Bus>
+void lcd_t<Bus>::flush(void)
 {
-    sendeByte(0x80+pos,0,0);
+    PROFILE_SCOPE(flushSite);
+    if (loeschenLohnt()) loesche();
+    //zeilenweise von links nach rechts, damit aufeinanderfolgende
+    //Aenderungen ohne neue Cursorposition auskommen
+    for (int z=0;z<2;z++)
+    {
+        for (int s=0;s<16;s++)
+        {
+            if (schatten[z][s]==anzeige[z][s]) continue;
+            uint8_t pos=z*0x40+s;
+            if (ddram!=pos)
+            {
+                sende(0x80+pos,0);
+                cgram=false;
+            }
+            sende(schatten[z][s],1);
+            anzeige[z][s]=schatten[z][s];
+            ddram=pos+1;
+        }
+        sendePuffer();
+    }
+}
+
+//Ob der 0x01-Befehl schneller ist, als die Stellen einzeln zu leeren. Er
+//kostet seine Ausfuehrungszeit, die warte per Busy-Flag abkuerzt, und
+//etwa eine Abfrage fuer die Uebertragung; ein Zeichen kostet 5
+//PCF8574-Bytes zu 9 Bittakten. Zeichen, die nach dem Loeschen wieder
+//geschrieben werden muessten, zaehlen dagegen.
+template <class Bus>
+bool lcd_t<Bus>::loeschenLohnt(void)
+{
+    int gespart=0;
+    for (int z=0;z<2;z++)
+    {
+        for (int s=0;s<16;s++)
+        {
+            if (anzeige[z][s]==' ') continue;
+            if (schatten[z][s]==' ') gespart++;
+            else if (schatten[z][s]==anzeige[z][s]) gespart--;
+        }
+    }
+    if (gespart<=0) return false;
+    uint32_t takt=hintergrund?i2c->asyncFrequency():i2c->frequency();
+    uint64_t zeichenUs=45000000ull*gespart/takt;
+    return zeichenUs>LCD_CLEAR_US+abfrageUs();
 }
-void lcd::init(void)
+
+//Loescht das Display mit dem 0x01-Befehl, direkt und nicht im Hintergrund,
+//damit warte danach das Busy-Flag abfragen kann
+template <class Bus>
+void lcd_t<Bus>::loesche(void)
+{
+    sendePuffer();
+    if (i2c->busy()) i2c->wait();
+    sendeByte(0x01,0,0);
+    memset(anzeige,' ',sizeof(anzeige));
+    ddram=0;
+    cgram=false;
+}
+
+template <class Bus>
+void lcd_t<Bus>::zeichen(uint8_t nummer, const uint8_t muster[8])
+{
+    //der Adresszaehler zeigt ab jetzt ins CGRAM
+    ddram=0xFF;
+    cgram=true;
+    sende(0x40+((nummer&0x07)<<3),0);
+    for (int z=0;z<8;z++) sende(muster[z]&0x1F,1);
+    sendePuffer();
+}
+
+template <class Bus>
+void lcd_t<Bus>::blockweise(bool an)
+{
+    block=an;
+}
+
+template <class Bus>
+void lcd_t<Bus>::asynchron(bool an)
+{
+    if (!an && i2c->busy()) i2c->wait();
+    hintergrund=an;
+}
+
+template <class Bus>
+void lcd_t<Bus>::sende(char b,uint8_t rs)
+{
+    if (block) puffere(b,rs);
+    else sendeByte(b,0,rs);
+}
+
+//Baut die Nibbles fuer puffer auf: Daten mit E=1, dann Daten mit E=0.
+//RS muss vor der steigenden Flanke von E stabil sein, deshalb steht vor
+//einem RS-Wechsel ein eigenes Byte mit E=0. Ist der Bus so schnell, dass
+//das naechste E=1 vor dem Ende der Ausfuehrung kaeme, folgen Fuellbytes.
+template <class Bus>
+void lcd_t<Bus>::puffere(char b,uint8_t rs)
+{
+    uint8_t steuer=0x08+(rs&0x01);
+    //puffer wird evtl. noch im Hintergrund uebertragen
+    if (anzahl==0 && i2c->busy()) i2c->wait();
+    //ein PCF8574-Byte dauert 9 Bittakte
+    uint32_t takt=hintergrund?i2c->asyncFrequency():i2c->frequency();
+    uint32_t byteNs=9000000000ull/takt;
+    uint32_t fuell=(ausfuehrung(b,rs)*1000u+byteNs-1)/byteNs-1;
+    if (anzahl+5u+fuell>sizeof(puffer)) sendePuffer();
+    if (anzahl==0 || (puffer[anzahl-1]&0x01)!=(rs&0x01))
+        puffer[anzahl++]=steuer;
+    puffer[anzahl++]=(b&0xF0)+steuer+0x04;
+    puffer[anzahl++]=(b&0xF0)+steuer;
+    puffer[anzahl++]=((b&0xF)<<4)+steuer+0x04;
+    puffer[anzahl++]=((b&0xF)<<4)+steuer;
+    while (fuell-->0) puffer[anzahl++]=steuer;
+}
+
+template <class Bus>
+void lcd_t<Bus>::sendePuffer(void)
+{
+    if (anzahl==0) return;
+    if (hintergrund) i2c->write(Adresse,puffer,anzahl,nullptr);
+    else i2c->write(Adresse,puffer,anzahl);
+    anzahl=0;
+}
+template <class Bus>
+void lcd_t<Bus>::init(void)
 {
     //Adresse=pAdresse<<1;
-    uint8_t data[1];
+    anzahl=0;
+    block=true;
+    hintergrund=true;
+    lesen=false;    //erst im 4-Bit-Modus lesbar
+    cgram=false;
+    uint8_t data[1]={0};
     for (Adresse=0;Adresse<255&&data[0]!=0x55;Adresse++)
     {
         i2c->write(Adresse,0x55);
@@ -113,13 +349,17 @@ void lcd::init(void)
     sendeNippel(0b0010,0,0);
 
     sendeByte(0b00101000,0,0);  //4Bit 2 Zeilen
+    lesen=true;
 
 
     sendeByte(0b00000001,0,0);  //display clear
+    memset(schatten,' ',sizeof(schatten));
+    memset(anzeige,' ',sizeof(anzeige));
 
     sendeByte(0b00000110,0,0);  //Increment Cursor*/
 
     sendeByte(0b10000000,0,0);  //Home
+    ddram=0;
 
     sendeByte(0b00001110,0,0);  //Display On    
 
@@ -131,15 +371,23 @@ void lcd::init(void)
     
     
 }
-int lcd::printf(const char *format, ...)
+template <class Bus>
+int lcd_t<Bus>::printf(const char *format, ...)
     {
     char buf[20];
     va_list args;
     va_start(args, format);
-    vsprintf(buf,format,args);
+    vsnprintf(buf,sizeof(buf),format,args);
     va_end(args);
     //LCD_i2c_textaus(buf);
     for (int i=0;i<16 && buf[i]!=0;i++)
-            sendeByte(buf[i],0,1);
+            schreibe(buf[i]);
+    flush();
     return 0;
-    }
\ No newline at end of file
+    }
+
+template class lcd_t<SoftwareI2C>;
+template class lcd_t<MockI2C>;
+#if DEVICE_I2C_ASYNCH
+template class lcd_t<HardwareI2C>;
+#endif
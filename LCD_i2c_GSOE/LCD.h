@@ -19,12 +19,38 @@
  * @endcode
  */
 
-//Anpassungen in SoftwareI2C.cpp: _frequency_delay = 3;
+//Bustakt: SoftwareI2C::setFrequency, Standard 100 kHz
+
+//Bus zum PCF8574, beim Uebersetzen waehlbar:
+//  SoftwareI2C  beliebige Pins, Standard
+//  HardwareI2C  I2C-Peripherie mit Interrupt-Uebertragung, nur an deren
+//               Pins, z.B. -DLCD_BUS=HardwareI2C -DLCD_SDA=PB_9 -DLCD_SCL=PB_8
+//  MockI2C      ohne Hardware, fuer Tests auf dem PC
+//Ein Bus braucht write/read wie SoftwareI2C, das asynchrone write mit
+//busy() und wait(), frequency() und asyncFrequency().
+
+#ifndef _LCD_H_
+#define _LCD_H_
 
 #include "mbed.h"
 #include "SoftwareI2C.h" 
+#include "HardwareI2C.h"
+#include "MockI2C.h"
+
+#ifndef LCD_BUS
+#define LCD_BUS SoftwareI2C
+#endif
+
+#ifndef LCD_SDA
+#define LCD_SDA PA_12
+#endif
+
+#ifndef LCD_SCL
+#define LCD_SCL PA_11
+#endif
    
-class lcd
+template <class Bus>
+class lcd_t
 {   
     private:
     uint8_t Adresse;//=0x3F;
@@ -32,22 +58,73 @@ class lcd
     //DigitalOut *nok;
     //PortOut *po;
     //DigitalIn *t;
-    SoftwareI2C *i2c;
+    Bus *i2c;
     uint8_t wert;
+    char schatten[2][16];   //Soll-Inhalt des Displays
+    char anzeige[2][16];    //Inhalt, der am Display steht
+    uint8_t zeile,spalte;   //Schreibposition in schatten
+    uint8_t ddram;          //Adresszaehler des Controllers, 0xFF unbekannt
+    bool cgram;             //Adresszaehler zeigt ins CGRAM
+    uint8_t puffer[72];     //PCF8574-Bytes fuer eine I2C-Uebertragung
+    uint8_t anzahl;         //Bytes in puffer
+    bool block;             //flush sendet zeilenweise als Block
+    bool lesen;             //Busy-Flag abfragen statt fest warten
+    bool hintergrund;       //Bloecke im Timer-Interrupt uebertragen
     public:
     /** Create LCD Instance
+    * @param sda, scl Pins des Busses
     */
-    lcd(void);
+    lcd_t(PinName sda=LCD_SDA,PinName scl=LCD_SCL);
     
     /** löscht das Display
     */
     void clear(void);
 
-    /** Positioniert den Cursor
+    /** Positioniert die Schreibposition
     * @param pos 0.. 0xF 1. Zeile, 0x40..0x4F 2. Zeile
     */
     void cursorpos(uint8_t pos);
 
+    /** Überträgt nur die Zeichen, die sich seit der letzten Übertragung
+    * geändert haben. clear, printf und putc rufen flush selbst auf.
+    */
+    void flush(void);
+
+    /** Definiert ein eigenes Zeichen im CGRAM. Stellen, die es schon
+    * zeigen, ändern sich sofort mit.
+    * @param nummer 0..7, ausgegeben als Code nummer+8, weil 0 printf
+    *               beendet
+    * @param muster 8 Zeilen von oben, Bits 4..0 die Punkte von links
+    */
+    void zeichen(uint8_t nummer, const uint8_t muster[8]);
+
+    /** Wählt, wie flush überträgt
+    * @param an true: eine I2C-Übertragung pro Zeile (Standard),
+    *           false: eine I2C-Übertragung pro PCF8574-Byte wie früher
+    */
+    void blockweise(bool an);
+
+    /** Wählt, wie die Blöcke von flush übertragen werden
+    * @param an true: im Hintergrund per Timer-Interrupt, der aufrufende
+    *           Thread schläft währenddessen (Standard), false: direkt
+    */
+    void asynchron(bool an);
+
+    /** Wählt, ob nach Befehlen das Busy-Flag abgefragt wird
+    * @param an true: abfragen, wo das schneller ist als die Wartezeit laut
+    *           Datenblatt (Standard), false: immer fest warten
+    */
+    void busyflag(bool an);
+
+    /** Ob das Busy-Flag abgefragt wird. Wird false, wenn das Lesen über
+    * den PCF8574 nicht funktioniert.
+    */
+    bool busyflag(void);
+
+    /** Der Bus, z.B. um in Tests das Protokoll von MockI2C zu lesen
+    */
+    Bus &bus(void) { return *i2c; }
+
     /** Print formattet
     * @param *format Formatstring
     * @param ... Variablenliste
@@ -71,9 +148,23 @@ class lcd
 
 
 private:
-    void warte(void);
+    void schreibe(char c);
+    void sende(char b,uint8_t rs);
+    void puffere(char b,uint8_t rs);
+    void sendePuffer(void);
+    void warte(char b,uint8_t rs);
+    bool warteBereit(uint16_t us);
+    uint32_t abfrageUs(void);
+    bool loeschenLohnt(void);
+    void loesche(void);
+    int8_t status(void);
     void sendeByte(char b,uint8_t rw, uint8_t rs );
     void sendeNippel(char b,uint8_t rw, uint8_t rs );
     void init(void);
 
 };
+
+/** Display am mit LCD_BUS gewaehlten Bus */
+typedef lcd_t<LCD_BUS> lcd;
+
+#endif
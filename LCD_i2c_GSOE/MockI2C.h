@@ -0,0 +1,98 @@
+/*
+ * I2C bus without hardware for tests of the lcd driver on the PC
+ */
+
+#ifndef _MOCK_I2C_H_
+#define _MOCK_I2C_H_
+
+#include "mbed.h"
+
+/**
+  * @brief MockI2C class
+  *
+  * Acknowledges one device address and answers reads with the last byte
+  * written, like the port latch of a PCF8574. All bytes written are logged.
+  * Asynchronous writes complete at once.
+  */
+class MockI2C {
+public:
+    MockI2C(PinName sda = NC, PinName scl = NC, uint8_t device_address = 0x4E)
+        : _device_address(device_address & 0xFE), _latch(0xFF), _frequency(100000),
+          _transfers(0), _logged(0) {}
+
+    void read(uint8_t device_address, uint8_t* data, uint8_t data_bytes) {
+        _transfers++;
+        bool ack = (device_address & 0xFE) == _device_address;
+        for (int x = 0; x < data_bytes; ++x) {
+            data[x] = ack ? _latch : 0xFF;  //nothing pulls SDA low
+        }
+    }
+
+    void write(uint8_t device_address, uint8_t* data, uint8_t data_bytes) {
+        write(device_address, (const uint8_t*)data, data_bytes, nullptr);
+    }
+
+    void write(uint8_t device_address, uint8_t byte) {
+        write(device_address, &byte, 1);
+    }
+
+    bool write(uint8_t device_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done) {
+        _transfers++;
+        bool ack = (device_address & 0xFE) == _device_address;
+        for (int x = 0; x < data_bytes && ack; ++x) {
+            _latch = data[x];
+            if (_logged < sizeof(_log)) _log[_logged++] = data[x];
+        }
+        if (done) done(ack);
+        return true;
+    }
+
+    bool busy() const {
+        return false;
+    }
+
+    bool wait() {
+        return true;
+    }
+
+    void setFrequency(uint32_t frequency) {
+        _frequency = frequency;
+    }
+
+    uint32_t frequency() const {
+        return _frequency;
+    }
+
+    uint32_t asyncFrequency() const {
+        return _frequency;
+    }
+
+    /** Number of transfers, reads and writes to any address */
+    uint32_t transfers() const {
+        return _transfers;
+    }
+
+    /** Bytes written to the device, the first 1024 */
+    const uint8_t* log() const {
+        return _log;
+    }
+
+    /** Number of bytes in log() */
+    uint16_t logged() const {
+        return _logged;
+    }
+
+    void clearLog() {
+        _logged = 0;
+    }
+
+private:
+    uint8_t _device_address;
+    uint8_t _latch;
+    uint32_t _frequency;
+    uint32_t _transfers;
+    uint16_t _logged;
+    uint8_t _log[1024];
+};
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Profiling probes for interrupts and driver hot paths, counted in core
+ * cycles of the DWT cycle counter like the delays in Delay.h.
+ */
+
+#include "Profile.h"
+#include "Delay.h"
+
+// Histogram buckets per report line
+#define REPORT_BUCKETS 4
+
+ProfileSite *ProfileSite::_first = NULL;
+
+ProfileSite::ProfileSite(const char *name)
+    : _name(name), _count(0), _min(UINT32_MAX), _max(0), _sum(0), _next(_first) {
+    memset(_histogram, 0, sizeof(_histogram));
+    _first = this;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void ProfileSite::report(Callback<void(const char *)> print) {
+    char line[80];
+    if (!_first) {
+        print("no profile sites, switch profile on in mbed_app.json");
+        return;
+    }
+    snprintf(line, sizeof(line), "%-15s %8s %6s %6s %6s cycles at %lu MHz", "site", "count",
+             "min", "mean", "max", (unsigned long)Delay::nsToCycles(1000));
+    print(line);
+    for (ProfileSite *site = _first; site; site = site->_next) {
+        // a copy, the interrupt of the site may add samples meanwhile
+        ProfileSite copy = *site;
+        if (copy._count == 0) continue;
+        snprintf(line, sizeof(line), "%-15s %8lu %6lu %6lu %6lu", copy._name,
+                 (unsigned long)copy._count, (unsigned long)copy._min,
+                 (unsigned long)(copy._sum / copy._count), (unsigned long)copy._max);
+        print(line);
+        // the buckets in use, as "<2^b:count"
+        int length = 0;
+        int shown = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            if (copy._histogram[b] == 0) continue;
+            length += snprintf(line + length, sizeof(line) - length, "%s%s2^%d:%lu",
+                               shown % REPORT_BUCKETS ? " " : "  ",
+                               b == BUCKETS - 1 ? ">=" : "<", b == BUCKETS - 1 ? b - 1 : b,
+                               (unsigned long)copy._histogram[b]);
+            if (++shown % REPORT_BUCKETS == 0) {
+                print(line);
+                length = 0;
+            }
+        }
+        if (length) print(line);
+    }
+}
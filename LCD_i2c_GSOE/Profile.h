@@ -0,0 +1,95 @@
+/*
+ * Profiling probes for interrupts and driver hot paths, counted in core
+ * cycles of the DWT cycle counter like the delays in Delay.h.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "mbed.h"
+
+/**
+  * @brief Cycle statistics of one code site
+  *
+  * Keeps count, min, max and sum of the cycles and a histogram with one
+  * bucket per power of two. A sample costs a few instructions, the CLZ
+  * finds the bucket. A site must only be hit from one context, e.g. one
+  * interrupt or one thread, the updates take no lock.
+  *
+  * The probes only exist if the app config profile is on, see
+  * mbed_app.json. Otherwise PROFILE_SITE, PROFILE_SCOPE and PROFILE_ADD
+  * compile to nothing.
+  *
+  * Example:
+  * @code
+  * PROFILE_SITE(stepSite, "stepper step");
+  * void Stepper::step() {
+  *     PROFILE_SCOPE(stepSite); // cycles until the function returns
+  *     ...
+  * }
+  * ProfileSite::report(print);
+  * @endcode
+  */
+class ProfileSite {
+public:
+    /** Buckets of the histogram, the last one counts all longer samples */
+    static const uint8_t BUCKETS = 24;
+
+    /** Create a site, at namespace scope, and switch the cycle counter on
+     * @param name Name in the report, at most 15 characters line up
+     */
+    explicit ProfileSite(const char *name);
+
+    /** Add a sample
+     * @param cycles Cycles it took
+     */
+    void add(uint32_t cycles) {
+        _count++;
+        _sum += cycles;
+        if (cycles < _min) _min = cycles;
+        if (cycles > _max) _max = cycles;
+        // bucket b holds 2^(b-1) to 2^b-1 cycles, bucket 0 holds 0
+        uint32_t bucket = cycles ? 32 - __builtin_clz(cycles) : 0;
+        _histogram[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+    }
+
+    /** Send the statistics of all sites, one line at a time, from a thread
+     * @param print Called for every line, without line end
+     */
+    static void report(Callback<void(const char *)> print);
+
+private:
+    const char *_name;
+    uint32_t _count;
+    uint32_t _min;
+    uint32_t _max;
+    uint64_t _sum;
+    uint32_t _histogram[BUCKETS];
+    ProfileSite *_next;
+    static ProfileSite *_first;
+};
+
+/**
+  * @brief Adds the cycles from its construction to its destruction to a site
+  */
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileSite &site) : _site(site), _start(DWT->CYCCNT) {}
+    ~ProfileScope() { _site.add(DWT->CYCCNT - _start); }
+
+private:
+    ProfileSite &_site;
+    uint32_t _start;
+};
+
+#if MBED_CONF_APP_PROFILE
+#define PROFILE_SITE(site, name) static ProfileSite site(name)
+#define PROFILE_SCOPE(site) ProfileScope profileScope(site)
+#define PROFILE_ADD(site, cycles) site.add(cycles)
+#else
+#define PROFILE_SITE(site, name)
+#define PROFILE_SCOPE(site)
+#define PROFILE_ADD(site, cycles)
+#endif
+
+#endif
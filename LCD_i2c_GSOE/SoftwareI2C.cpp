@@ -5,6 +5,10 @@
  */
 
 #include "SoftwareI2C.h"
+#include "Profile.h"
+
+PROFILE_SITE(writeSite, "i2c write");
+PROFILE_SITE(stepSite, "i2c step");
 
 /**
  * @brief Initializes interface
@@ -12,7 +16,7 @@
  * @param scl GPIO pin to use as I2C SCL
  */
 
-SoftwareI2C::SoftwareI2C(PinName sda, PinName scl) : _sda(sda) , _scl(scl) {
+SoftwareI2C::SoftwareI2C(PinName sda, PinName scl) : _sda(sda) , _scl(scl), _phase(IDLE), _ok(true) {
     //masse=0;
     _scl.output();
     _scl.mode(OpenDrain);
@@ -21,8 +25,8 @@ SoftwareI2C::SoftwareI2C(PinName sda, PinName scl) : _sda(sda) , _scl(scl) {
     _sda.mode(OpenDrain);
 
     _device_address = 0;
-    if (HAL_GetDEVID () ==0x437) _frequency_delay = 20;//3;
-    else _frequency_delay = 60;//3;
+    setFrequency(100000);
+    setAsyncFrequency(20000);
 
 
     initialise();
@@ -32,6 +36,41 @@ SoftwareI2C::~SoftwareI2C() {
 
 }
 
+// Minimum SCL low and high times of the I2C specification in ns
+struct I2CTiming {
+    uint32_t frequency;
+    uint32_t low;
+    uint32_t high;
+};
+
+static const I2CTiming timings[] = {
+    {100000, 4700, 4000},   //Standard-mode
+    {400000, 1300, 600},    //Fast-mode
+    {1000000, 500, 260},    //Fast-mode Plus
+};
+
+/**
+ * @brief Sets the SCL frequency
+ * @param frequency SCL frequency in Hz, at most 1 MHz
+ */
+void SoftwareI2C::setFrequency(uint32_t frequency) {
+    if (frequency == 0) frequency = 100000;
+    if (frequency > 1000000) frequency = 1000000;
+    const I2CTiming *timing = timings;
+    while (timing->frequency < frequency) ++timing;
+
+    // the period is split in the ratio of the minimum times, slower
+    // frequencies of a mode just stretch both halves
+    uint32_t period = 1000000000 / frequency;
+    uint32_t low = period * timing->low / (timing->low + timing->high);
+    if (low < timing->low) low = timing->low;
+    uint32_t high = period > low + timing->high ? period - low : timing->high;
+
+    _frequency = frequency;
+    _tief = Delay::nsToCycles(low);
+    _hoch = Delay::nsToCycles(high);
+}
+
 /**
  * @brief Read 1 or more bytes from the I2C slave
  * @param device_address The address of the device to read from
@@ -40,7 +79,7 @@ SoftwareI2C::~SoftwareI2C() {
  */
 void SoftwareI2C::read(uint8_t device_address, uint8_t* data, uint8_t data_bytes) {
     if (data == 0 || data_bytes == 0) return;
-    __disable_irq();
+    // no interrupt lock, see write
     device_address = device_address | 0x01;
     start();
     putByte(device_address);
@@ -52,7 +91,6 @@ void SoftwareI2C::read(uint8_t device_address, uint8_t* data, uint8_t data_bytes
         }
     }
     stop();
-    __enable_irq();
 }
 
 /**
@@ -63,7 +101,9 @@ void SoftwareI2C::read(uint8_t device_address, uint8_t* data, uint8_t data_bytes
  */
 void SoftwareI2C::write(uint8_t device_address, uint8_t* data,  uint8_t data_bytes) {
     if (data == 0 || data_bytes == 0) return;
-    __disable_irq();
+    PROFILE_SCOPE(writeSite);
+    // no interrupt lock: the master drives SCL, so being interrupted only
+    // stretches the transfer, like in the single byte write
     device_address = device_address & 0xFE;
     start();
     putByte(device_address);
@@ -73,7 +113,6 @@ void SoftwareI2C::write(uint8_t device_address, uint8_t* data,  uint8_t data_byt
         getAck();
     }
     stop();
-    __enable_irq();
 }
 
 /**
@@ -82,6 +121,7 @@ void SoftwareI2C::write(uint8_t device_address, uint8_t* data,  uint8_t data_byt
  * @param byte The data to write
  */
 void SoftwareI2C::write(uint8_t device_address, uint8_t byte) {
+    PROFILE_SCOPE(writeSite);
     device_address = device_address & 0xFE;
     start();
     putByte(device_address);
@@ -166,6 +206,203 @@ void SoftwareI2C::randomWrite(uint8_t device_address, uint8_t start_address, uin
     stop();
 }
 
+/**
+ * @brief Sets the SCL frequency of asynchronous transfers
+ * @param frequency SCL frequency in Hz, at most 500 kHz
+ */
+void SoftwareI2C::setAsyncFrequency(uint32_t frequency) {
+    if (frequency == 0) frequency = 20000;
+    _half_period = (500000 + frequency - 1) / frequency;
+}
+
+// Event flag set at the end of an asynchronous transfer
+#define FLAG_DONE 1
+
+/**
+ * @brief Read 1 or more bytes from the I2C slave without waiting
+ * @param device_address The address of the device to read from
+ * @param data An allocated array to read the data into, valid until done is called
+ * @param data_bytes Number of bytes to read
+ * @param done Called in interrupt context with whether the slave acknowledged
+ * @return false if another transfer is running
+ */
+bool SoftwareI2C::read(uint8_t device_address, uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done) {
+    if (data == 0 || data_bytes == 0 || busy()) return false;
+    _segment_count = 0;
+    _address[0] = device_address | 0x01;
+    addSegment(_address, 1, false, false);
+    addSegment(data, data_bytes, true, false);
+    return begin(done);
+}
+
+/**
+ * @brief Write 1 or more bytes to the I2C slave without waiting
+ * @param device_address The address of the device to write to
+ * @param data An array to write the data from, valid until done is called
+ * @param data_bytes Number of bytes to write from array
+ * @param done Called in interrupt context with whether the slave acknowledged
+ * @return false if another transfer is running
+ */
+bool SoftwareI2C::write(uint8_t device_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done) {
+    if (data == 0 || data_bytes == 0 || busy()) return false;
+    _segment_count = 0;
+    _address[0] = device_address & 0xFE;
+    addSegment(_address, 1, false, false);
+    addSegment((uint8_t*)data, data_bytes, false, false);
+    return begin(done);
+}
+
+/**
+ * @brief Read 1 or more bytes from the I2C slave at the specified memory address without waiting
+ * @param device_address The address of the device to read from
+ * @param start_address The memory address to read from
+ * @param data The allocated array to read into, valid until done is called
+ * @param data_bytes The number of bytes to read
+ * @param done Called in interrupt context with whether the slave acknowledged
+ * @return false if another transfer is running
+ */
+bool SoftwareI2C::randomRead(uint8_t device_address, uint8_t start_address, uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done) {
+    if (data == 0 || data_bytes == 0 || busy()) return false;
+    _segment_count = 0;
+    _address[0] = device_address & 0xFE;
+    _address[1] = start_address;
+    _address[2] = device_address | 0x01;
+    addSegment(_address, 2, false, false);
+    addSegment(_address + 2, 1, false, true);
+    addSegment(data, data_bytes, true, false);
+    return begin(done);
+}
+
+/**
+ * @brief Write 1 or more bytes to the I2C slave at the specified memory address without waiting
+ * @param device_address The address of the device to write to
+ * @param start_address The memory address to write to
+ * @param data The data to write, valid until done is called
+ * @param data_bytes The number of bytes to write
+ * @param done Called in interrupt context with whether the slave acknowledged
+ * @return false if another transfer is running
+ */
+bool SoftwareI2C::randomWrite(uint8_t device_address, uint8_t start_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done) {
+    if (data == 0 || data_bytes == 0 || busy()) return false;
+    _segment_count = 0;
+    _address[0] = device_address & 0xFE;
+    _address[1] = start_address;
+    addSegment(_address, 2, false, false);
+    addSegment((uint8_t*)data, data_bytes, false, false);
+    return begin(done);
+}
+
+/**
+ * @brief Sleeps until the asynchronous transfer has finished
+ * @return Whether the slave acknowledged the last transfer
+ */
+bool SoftwareI2C::wait() {
+    if (busy()) _done_flag.wait_any(FLAG_DONE);
+    return _ok;
+}
+
+void SoftwareI2C::addSegment(uint8_t* data, uint8_t count, bool read, bool restart) {
+    Segment &segment = _segments[_segment_count++];
+    segment.data = data;
+    segment.count = count;
+    segment.read = read;
+    segment.restart = restart;
+}
+
+bool SoftwareI2C::begin(Callback<void(bool)> done) {
+    _done = done;
+    _done_flag.clear(FLAG_DONE);
+    _segment = 0;
+    _index = 0;
+    _byte = _segments[0].data[0];
+    _ok = true;
+    _phase = START_SDA;
+    _clock.attach(callback(this, &SoftwareI2C::step), std::chrono::microseconds(_half_period));
+    return true;
+}
+
+// Moves on to the next byte, false at the end of the transfer
+bool SoftwareI2C::nextByte() {
+    Segment *segment = &_segments[_segment];
+    if (segment->read) segment->data[_index] = _byte;
+    if (++_index >= segment->count) {
+        if (++_segment >= _segment_count) return false;
+        _index = 0;
+        segment = &_segments[_segment];
+    }
+    _byte = segment->read ? 0 : segment->data[_index];
+    _bit = 0;
+    return true;
+}
+
+// One SCL half period, runs in the timer interrupt. Data is changed while
+// SCL is low and sampled just before SCL goes low again.
+void SoftwareI2C::step() {
+    PROFILE_SCOPE(stepSite);
+    switch (_phase) {
+    case START_SDA:
+        _sda = 1;
+        _phase = START_SCL;
+        break;
+    case START_SCL:
+        _scl = 1;
+        _phase = START_LOW;
+        break;
+    case START_LOW:
+        _sda = 0;
+        _bit = 0;
+        _phase = BIT_LOW;
+        break;
+    case BIT_LOW: {
+        Segment &segment = _segments[_segment];
+        int level = _sda;
+        _scl = 0;
+        if (_bit == 9) {
+            // the slave did not acknowledge: give up with a STOP
+            if (!segment.read && level) _ok = false;
+            if (!_ok || !nextByte()) {
+                _sda = 0;
+                _phase = STOP_SCL;
+                break;
+            }
+            if (_index == 0 && _segments[_segment].restart) {
+                _sda = 1;
+                _phase = START_SCL;
+                break;
+            }
+        } else if (_bit > 0 && segment.read) {
+            _byte = (_byte << 1) | level;
+        }
+        Segment &current = _segments[_segment];
+        if (_bit < 8) {
+            _sda = current.read ? 1 : (_byte >> (7 - _bit)) & 1;
+        } else {
+            // acknowledge every byte read but the last
+            bool last = _segment == _segment_count - 1 && _index == current.count - 1;
+            _sda = current.read ? last : 1;
+        }
+        _bit++;
+        _phase = BIT_HIGH;
+        break;
+    }
+    case BIT_HIGH:
+        _scl = 1;
+        _phase = BIT_LOW;
+        break;
+    case STOP_SCL:
+        _scl = 1;
+        _phase = STOP_SDA;
+        break;
+    case STOP_SDA:
+        _sda = 1;
+        _phase = IDLE;
+        _done_flag.set(FLAG_DONE);
+        if (_done) _done(_ok);
+        return;
+    }
+    _clock.attach_absolute(callback(this, &SoftwareI2C::step), _clock.scheduled_time() + std::chrono::microseconds(_half_period));
+}
+
 /**
  * @brief Read 2 bytes from the I2C slave at the specified memory address and return them as an 16bit unsigned integer
  * @param device_address The address of the device to read from
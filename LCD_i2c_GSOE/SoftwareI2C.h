@@ -8,6 +8,7 @@
 #define _SOFTWARE_I2C_H_
 
 #include "mbed.h"
+#include "Delay.h"
 
 /**
   * @brief SoftwareI2C class
@@ -25,6 +26,33 @@ public:
     void randomWrite(uint8_t device_address, uint8_t start_address, uint8_t* data, uint8_t data_bytes);
     void randomWrite(uint8_t device_address, uint8_t start_address, uint8_t byte);
     
+    /** Start a read without waiting for it. The transfer runs in a timer
+     * interrupt that advances the bus by one SCL half period at a time.
+     * @param done Called in interrupt context at the end with whether the
+     *        slave acknowledged, may be NULL. data must stay valid until then.
+     * @return false if another asynchronous transfer is still running
+     */
+    bool read(uint8_t device_address, uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done);
+
+    /** Start a write without waiting for it, see the asynchronous read */
+    bool write(uint8_t device_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done);
+
+    /** Start a read at a memory address without waiting for it */
+    bool randomRead(uint8_t device_address, uint8_t start_address, uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done);
+
+    /** Start a write to a memory address without waiting for it */
+    bool randomWrite(uint8_t device_address, uint8_t start_address, const uint8_t* data, uint8_t data_bytes, Callback<void(bool)> done);
+
+    /** Whether an asynchronous transfer is running */
+    bool busy() const {
+        return _phase != IDLE;
+    }
+
+    /** Sleep until the asynchronous transfer has finished, thread context only
+     * @return Whether the slave acknowledged the last transfer
+     */
+    bool wait();
+
     uint8_t read8(uint8_t device_address, uint8_t start_address);
     uint16_t read16(uint8_t device_address, uint8_t start_address);
     uint32_t read24(uint8_t device_address, uint8_t start_address);
@@ -34,8 +62,28 @@ public:
         _device_address = address;
     }
     
-    void setFrequency(uint32_t frequency){
-        _frequency_delay = 1000000 / frequency;
+    /** Set the SCL frequency
+     * @param frequency 100000, 400000 or 1000000 Hz, or anything in between.
+     *        The bus phases keep the minimum times of the I2C specification
+     *        for the mode, measured with the calibrated cycle counter.
+     */
+    void setFrequency(uint32_t frequency);
+
+    /** SCL frequency set with setFrequency, 100 kHz by default */
+    uint32_t frequency() const {
+        return _frequency;
+    }
+
+    /** Set the SCL frequency of asynchronous transfers
+     * @param frequency Up to 500 kHz, 20 kHz by default. Every half period
+     *        is one timer interrupt, which takes a few us on the target, so
+     *        faster clocks mostly move CPU time into interrupts.
+     */
+    void setAsyncFrequency(uint32_t frequency);
+
+    /** SCL frequency of asynchronous transfers */
+    uint32_t asyncFrequency() const {
+        return 500000 / _half_period;
     }
 
     inline void initialise() {
@@ -46,7 +94,8 @@ public:
         
         _sda = 1;
         _scl = 0;
-        warte(_frequency_delay);
+        beginne();
+        warte(_tief);
 
         for ( int n = 0; n <= 3; ++n ) {
             stop();
@@ -54,43 +103,47 @@ public:
     }
 
 private:
-    void warte(int zeit)
-    {
-     for (int i=0;i<zeit*5;i++)
-     {
-      asm("nop\n\t");   
-     }   
+    // Both lines stay open drain outputs: writing 1 releases a line and
+    // reading it returns the bus level. Switching the direction would
+    // change the port's mode registers in a critical section for every
+    // byte, nothing else needs interrupts masked.
+
+    // Each phase ends a given number of cycles after the previous one, so
+    // the time the pin accesses take counts towards the phase
+    inline void beginne() {
+        _zeit = Delay::cycles();
     }
+
+    inline void warte(uint32_t zyklen) {
+        _zeit = Delay::until(_zeit + zyklen);
+    }
+
     inline void start() {
-        _sda.output();
-        warte(_frequency_delay);
-        _scl = 1;
+        if (busy()) wait();
+        beginne();
         _sda = 1;
-        warte(_frequency_delay);
+        _scl = 1;
+        warte(_tief);           //tSU;STA, tBUF
         _sda = 0;
-        warte(_frequency_delay);
+        warte(_hoch);           //tHD;STA
         _scl = 0;
-        warte(_frequency_delay);
     }
 
     inline void stop() {
-        _sda.output();
-        warte(_frequency_delay);
         _sda = 0;
-        warte(_frequency_delay);
+        warte(_tief);
         _scl = 1;
-        warte(_frequency_delay);
+        warte(_hoch);           //tSU;STO
         _sda = 1;
+        warte(_tief);           //tBUF
     }
 
     inline void putByte(uint8_t byte) {
-        _sda.output();
         for ( int n = 8; n > 0; --n) {
-            warte(_frequency_delay);
             _sda = byte & (1 << (n-1));
-            warte(_frequency_delay); //2.12.21
+            warte(_tief);       //tLOW, includes tSU;DAT
             _scl = 1;
-            warte(_frequency_delay);
+            warte(_hoch);       //tHIGH
             _scl = 0;
         }
         _sda = 1;
@@ -99,51 +152,54 @@ private:
     inline uint8_t getByte() {
         uint8_t byte = 0;
 
-        _sda.input();          //release the data line
-        _sda.mode(OpenDrain);
-        
-        warte(_frequency_delay);
+        _sda = 1;              //release the data line
 
         for ( int n = 8; n > 0; --n ) {
+            warte(_tief);
             _scl=1;            //set clock high
-            warte(_frequency_delay);
-            byte |= _sda << (n-1); //read the bit
-            warte(_frequency_delay);
+            warte(_hoch);
+            byte |= _sda << (n-1); //read the bit while the clock is high
             _scl=0;            //set clock low
-            warte(_frequency_delay);
         }
 
-        _sda.output();         //take data line back
-
         return byte;
     }
 
     inline void giveAck() {
-        _sda.output();
-        warte(_frequency_delay);
         _sda = 0;
-        warte(_frequency_delay); //2.12.21
+        warte(_tief);
         _scl = 1;
-        warte(_frequency_delay);
+        warte(_hoch);
         _scl = 0;
         _sda = 1;
 
     }
 
     inline bool getAck() {
-        _sda.output();
-        _sda = 1;
+        _sda = 1;              //release the data line
+        warte(_tief);
         _scl = 1;
-        _sda.input();
-        _sda.mode(OpenDrain);
-        warte(_frequency_delay);
+        warte(_hoch);
+        bool ack = _sda == 0;  //the slave holds SDA until the clock falls
         _scl = 0;
+        return ack;
+    }
 
-        if(_sda != 0){return false;}
+    // Asynchronous transfers: one segment of bytes after another, each
+    // byte is 9 bits of two half periods
+    enum Phase { IDLE, START_SDA, START_SCL, START_LOW, BIT_LOW, BIT_HIGH, STOP_SCL, STOP_SDA };
 
-        warte(_frequency_delay);
-        return true;
-    }
+    struct Segment {
+        uint8_t* data;
+        uint8_t count;
+        bool read;
+        bool restart;       //repeated START before the segment
+    };
+
+    bool begin(Callback<void(bool)> done);
+    void addSegment(uint8_t* data, uint8_t count, bool read, bool restart);
+    bool nextByte();
+    void step();
 
     DigitalInOut _sda;
     DigitalInOut _scl;
@@ -151,7 +207,24 @@ private:
     //DigitalOut _scl;
     
     uint8_t _device_address;
-    uint32_t _frequency_delay;
+    uint32_t _frequency;
+    uint32_t _hoch;     //cycles SCL high
+    uint32_t _tief;     //cycles SCL low
+    uint32_t _zeit;     //cycle count at the end of the last phase
+
+    Timeout _clock;
+    EventFlags _done_flag;
+    Callback<void(bool)> _done;
+    uint32_t _half_period;          //us
+    Segment _segments[4];
+    uint8_t _address[3];            //address bytes and start address
+    uint8_t _segment_count;
+    uint8_t _segment;
+    uint8_t _index;                 //byte in the segment
+    uint8_t _bit;                   //bits of the byte clocked so far
+    uint8_t _byte;
+    uint8_t volatile _phase;
+    bool volatile _ok;
 };
 
 #endif
\ No newline at end of file
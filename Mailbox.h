@@ -0,0 +1,88 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "mbed.h"
+
+#include "IrqLock.h"
+#include "SpscQueue.h"
+
+/** Typed messages from interrupts and threads to one receiving thread.
+ *
+ * post() copies the message into a lock-free queue and sets an event flag,
+ * so it takes constant time and is safe from interrupts. The queue takes
+ * one producer at a time, so post() copies the message under an IrqLock:
+ * any number of threads and interrupts of any priority up to the IrqLock
+ * ceiling can post. An interrupt above the ceiling, e.g. the emergency
+ * stop, is not kept out by the lock and must not post, post() asserts
+ * this. Only one thread may receive.
+ *
+ * Example:
+ * @code
+ * struct Command { uint8_t kind; uint16_t value; };
+ * Mailbox<Command, 8> commands;
+ * commands.post(Command{1, 100});     // from anywhere
+ * while (true) {                      // in the receiving thread
+ *   Command command;
+ *   commands.receive(command);
+ *   execute(command);
+ * }
+ * @endcode
+ *
+ * @tparam T Message type, copied in and out
+ * @tparam Size Number of messages that can wait, a power of two
+ */
+template <typename T, uint16_t Size> class Mailbox {
+public:
+  /** Send a message
+   * @return false if the mailbox was full, the message is dropped then
+   */
+  bool post(const T &message) {
+    MBED_ASSERT(IrqLock::masksCaller());
+    bool posted;
+    {
+      IrqLock lock;
+      posted = _queue.push(message);
+    }
+    _posted.set(FLAG_POSTED);
+    return posted;
+  }
+
+  /** Wait for the next message, receiving thread only */
+  void receive(T &message) {
+    while (!_queue.pop(message))
+      _posted.wait_any(FLAG_POSTED);
+  }
+
+  /** Wait for the next message until a point in time, receiving thread only
+   * @param until Time to give up
+   * @return false if no message came in time
+   */
+  bool receive(T &message, Kernel::Clock::time_point until) {
+    while (!_queue.pop(message)) {
+      Kernel::Clock::time_point now = Kernel::Clock::now();
+      if (now >= until)
+        return false;
+      _posted.wait_any_for(FLAG_POSTED, until - now);
+    }
+    return true;
+  }
+
+  /** Take the next message if there is one, receiving thread only
+   * @return false if the mailbox was empty
+   */
+  bool tryReceive(T &message) { return _queue.pop(message); }
+
+  /** Highest number of messages waiting at once */
+  uint16_t maxDepth() const { return _queue.maxDepth(); }
+
+  /** Number of messages dropped because the mailbox was full */
+  uint32_t dropped() const { return _queue.dropped(); }
+
+private:
+  static const uint32_t FLAG_POSTED = 1;
+
+  SpscQueue<T, Size> _queue;
+  EventFlags _posted;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <stdint.h>
+
+/** Shape of the velocity ramp between two speed levels */
+enum RampKind {
+  RAMP_TRAPEZOIDAL, ///< Constant acceleration
+  RAMP_S_CURVE      ///< Jerk limited, acceleration rises and falls linearly
+};
+
+namespace motion {
+
+// Speeds are steps/s in Q16.16 fixed point, times are in us
+typedef uint32_t fixed_t;
+
+constexpr fixed_t toFixed(uint32_t stepsPerSecond) {
+  return stepsPerSecond << 16;
+}
+
+// Step interval in us for a speed
+constexpr uint32_t intervalUs(fixed_t speed) {
+  return (uint32_t)((1000000ull << 16) / speed);
+}
+
+constexpr uint64_t isqrt(uint64_t value) {
+  uint64_t result = 0;
+  uint64_t bit = 1ull << 62;
+  while (bit > value)
+    bit >>= 2;
+  while (bit != 0) {
+    if (value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+// Walks a ramp from one speed level to the next, one step at a time. The
+// trapezoidal ramp uses v(n) = sqrt(v0^2 + 2an), the S-curve ramp two
+// phases of constant jerk with peak acceleration accel in the middle.
+struct Segment {
+  RampKind kind;
+  fixed_t from;
+  fixed_t to;
+  uint32_t accel; // steps/s^2
+  uint32_t step;
+  uint64_t time;
+  uint64_t duration;
+  fixed_t speed;
+
+  constexpr Segment(RampKind kind, fixed_t from, fixed_t to, uint32_t accel)
+      : kind(kind), from(from), to(to), accel(accel), step(0), time(0),
+        duration(2000000ull * (to - from) / ((uint64_t)accel << 16)),
+        speed(from) {}
+
+  constexpr bool done() const { return speed >= to; }
+
+  constexpr void next() {
+    time += intervalUs(speed);
+    step++;
+    if (kind == RAMP_TRAPEZOIDAL) {
+      speed = (fixed_t)isqrt((uint64_t)from * from +
+                             ((uint64_t)2 * accel * step << 32));
+    } else if (time >= duration) {
+      speed = to;
+    } else {
+      uint64_t delta = to - from;
+      if (2 * time < duration) {
+        uint64_t ratio = (time << 16) / duration;
+        speed = from + (fixed_t)((2 * delta * ratio * ratio) >> 32);
+      } else {
+        uint64_t ratio = ((duration - time) << 16) / duration;
+        speed = to - (fixed_t)((2 * delta * ratio * ratio) >> 32);
+      }
+    }
+  }
+};
+
+template <uint32_t... Speeds>
+constexpr uint16_t profileLength(RampKind kind, uint32_t accel) {
+  const uint32_t speeds[] = {Speeds...};
+  uint16_t length = 1;
+  for (unsigned i = 0; i + 1 < sizeof...(Speeds); i++) {
+    Segment segment(kind, toFixed(speeds[i]), toFixed(speeds[i + 1]), accel);
+    while (!segment.done()) {
+      segment.next();
+      length++;
+    }
+  }
+  return length;
+}
+
+template <uint16_t Length, uint8_t Levels> struct ProfileTable {
+  uint32_t interval[Length]; // step intervals in us, by increasing speed
+  uint16_t index[Levels];    // table index of every speed level
+  uint32_t speed[Levels];    // speed levels in steps/s
+};
+
+template <uint16_t Length, uint32_t... Speeds>
+constexpr ProfileTable<Length, sizeof...(Speeds)> makeProfile(RampKind kind,
+                                                            uint32_t accel) {
+  ProfileTable<Length, sizeof...(Speeds)> table{};
+  const uint32_t speeds[] = {Speeds...};
+  uint16_t n = 0;
+  for (unsigned i = 0; i + 1 < sizeof...(Speeds); i++) {
+    table.index[i] = n;
+    table.speed[i] = speeds[i];
+    Segment segment(kind, toFixed(speeds[i]), toFixed(speeds[i + 1]), accel);
+    while (!segment.done()) {
+      table.interval[n++] = intervalUs(segment.speed);
+      segment.next();
+    }
+  }
+  table.index[sizeof...(Speeds) - 1] = n;
+  table.speed[sizeof...(Speeds) - 1] = speeds[sizeof...(Speeds) - 1];
+  table.interval[n] = intervalUs(toFixed(speeds[sizeof...(Speeds) - 1]));
+  return table;
+}
+
+template <uint32_t First> constexpr bool ascending() { return true; }
+
+template <uint32_t First, uint32_t Second, uint32_t... Rest>
+constexpr bool ascending() {
+  return First < Second && ascending<Second, Rest...>();
+}
+
+} // namespace motion
+
+/** Velocity ramps between a fixed set of speed levels, computed at compile
+ * time.
+ *
+ * All ramps are chained into one table of step intervals ordered by
+ * increasing speed, with one entry per step. Accelerating walks the table
+ * up, decelerating walks it down, so the step interrupt only needs one table
+ * lookup per step and a ramp can be retargeted at any time without a jump in
+ * speed.
+ *
+ * Example:
+ * @code
+ * typedef MotionProfile<RAMP_S_CURVE, 100, 20, 50, 100> Profile;
+ * stepper.setProfile(Profile::intervals());
+ * stepper.rampTo(Profile::index(100));
+ * @endcode
+ *
+ * @tparam Kind Ramp shape
+ * @tparam Accel Acceleration in steps/s^2, peak acceleration for S-curves
+ * @tparam Speeds Speed levels in steps/s, ascending
+ */
+template <RampKind Kind, uint32_t Accel, uint32_t... Speeds>
+class MotionProfile {
+  static_assert(sizeof...(Speeds) > 0, "at least one speed level needed");
+  static_assert(motion::ascending<Speeds...>(),
+                "speed levels must be ascending");
+
+public:
+  /** Number of entries in the interval table */
+  static constexpr uint16_t length =
+      motion::profileLength<Speeds...>(Kind, Accel);
+
+  /** Step intervals in us, one entry per step */
+  static const uint32_t *intervals() { return table.interval; }
+
+  /** Table index of a speed level
+   * @param speed One of the speed levels in steps/s
+   * @return Index into intervals(), 0 for unknown speeds
+   */
+  static uint16_t index(uint32_t speed) {
+    for (unsigned i = 0; i < sizeof...(Speeds); i++) {
+      if (table.speed[i] == speed)
+        return table.index[i];
+    }
+    return 0;
+  }
+
+private:
+  static constexpr motion::ProfileTable<length, sizeof...(Speeds)> table =
+      motion::makeProfile<length, Speeds...>(Kind, Accel);
+};
+
+template <RampKind Kind, uint32_t Accel, uint32_t... Speeds>
+constexpr uint16_t MotionProfile<Kind, Accel, Speeds...>::length;
+
+template <RampKind Kind, uint32_t Accel, uint32_t... Speeds>
+constexpr motion::ProfileTable<MotionProfile<Kind, Accel, Speeds...>::length,
+                               sizeof...(Speeds)>
+    MotionProfile<Kind, Accel, Speeds...>::table;
+
+#endif
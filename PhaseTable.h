@@ -0,0 +1,129 @@
+#ifndef PHASE_TABLE_H
+#define PHASE_TABLE_H
+
+#include <stdint.h>
+
+/** Coil drive sequence of a unipolar stepper motor */
+enum DriveMode {
+  DRIVE_WAVE,      ///< One coil at a time, 4 phases
+  DRIVE_FULL_STEP, ///< Two neighbouring coils at a time, 4 phases
+  DRIVE_HALF_STEP  ///< Alternating one and two coils, 8 phases
+};
+
+namespace phase {
+
+constexpr unsigned bitCount(unsigned mask) {
+  return mask == 0 ? 0 : (mask & 1) + bitCount(mask >> 1);
+}
+
+// Port bit of a coil, coils are the set bits of mask from the lowest up
+constexpr unsigned coilBit(unsigned mask, unsigned coil) {
+  return coil == 0 ? mask & -mask : coilBit(mask & (mask - 1), coil - 1);
+}
+
+constexpr unsigned pattern(unsigned mask, DriveMode mode, unsigned i) {
+  return mode == DRIVE_WAVE ? coilBit(mask, i)
+         : mode == DRIVE_FULL_STEP
+             ? coilBit(mask, i) | coilBit(mask, (i + 1) % 4)
+         : i % 2 == 0 ? coilBit(mask, i / 2)
+                      : coilBit(mask, i / 2) | coilBit(mask, (i / 2 + 1) % 4);
+}
+
+// Word for the bit set/reset register: pattern bits on, other coils off
+constexpr uint32_t setReset(unsigned mask, unsigned pattern) {
+  return pattern | (uint32_t)(mask & ~pattern) << 16;
+}
+
+template <uint8_t Length> struct Phases {
+  unsigned int pattern[Length];
+};
+
+template <uint8_t Length> struct SetResetPhases {
+  uint32_t word[Length];
+};
+
+// Counter-clockwise runs the clockwise sequence backwards from phase 0
+template <uint8_t Length>
+constexpr Phases<Length> makePhases(unsigned mask, DriveMode mode, bool ccw) {
+  Phases<Length> phases{};
+  for (unsigned i = 0; i < Length; i++)
+    phases.pattern[i] = pattern(mask, mode, ccw ? (Length - i) % Length : i);
+  return phases;
+}
+
+template <uint8_t Length>
+constexpr SetResetPhases<Length> makeSetResetPhases(unsigned mask,
+                                                    DriveMode mode, bool ccw) {
+  SetResetPhases<Length> phases{};
+  for (unsigned i = 0; i < Length; i++)
+    phases.word[i] =
+        setReset(mask, pattern(mask, mode, ccw ? (Length - i) % Length : i));
+  return phases;
+}
+
+} // namespace phase
+
+/** Coil patterns for a stepper motor on four port bits, generated at compile
+ * time, as port values and as words for the bit set/reset register.
+ *
+ * Example:
+ * @code
+ * EventScheduler steps;
+ * GpioOut<PortC, 0xf00> motor;
+ * typedef PhaseTable<0xf00, DRIVE_HALF_STEP> Phases;
+ * Stepper stepper(steps, motor.bits(), Phases::cwSetReset(), Phases::length);
+ * @endcode
+ *
+ * @tparam Mask Port mask of the four coils, coil A is the lowest bit
+ * @tparam Mode Drive sequence
+ */
+template <unsigned Mask, DriveMode Mode> class PhaseTable {
+  static_assert(phase::bitCount(Mask) == 4, "mask must select four coils");
+
+public:
+  /** Number of phases per electrical cycle */
+  static constexpr uint8_t length = Mode == DRIVE_HALF_STEP ? 8 : 4;
+
+  /** Clockwise phase patterns */
+  static const unsigned int *cw() { return _cw.pattern; }
+
+  /** Counter-clockwise phase patterns */
+  static const unsigned int *ccw() { return _ccw.pattern; }
+
+  /** Clockwise phases as BSRR words, one store switches all four coils */
+  static const uint32_t *cwSetReset() { return _cwSetReset.word; }
+
+  /** Counter-clockwise phases as BSRR words */
+  static const uint32_t *ccwSetReset() { return _ccwSetReset.word; }
+
+private:
+  static constexpr phase::Phases<length> _cw =
+      phase::makePhases<length>(Mask, Mode, false);
+  static constexpr phase::Phases<length> _ccw =
+      phase::makePhases<length>(Mask, Mode, true);
+  static constexpr phase::SetResetPhases<length> _cwSetReset =
+      phase::makeSetResetPhases<length>(Mask, Mode, false);
+  static constexpr phase::SetResetPhases<length> _ccwSetReset =
+      phase::makeSetResetPhases<length>(Mask, Mode, true);
+};
+
+template <unsigned Mask, DriveMode Mode>
+constexpr uint8_t PhaseTable<Mask, Mode>::length;
+
+template <unsigned Mask, DriveMode Mode>
+constexpr phase::Phases<PhaseTable<Mask, Mode>::length>
+    PhaseTable<Mask, Mode>::_cw;
+
+template <unsigned Mask, DriveMode Mode>
+constexpr phase::Phases<PhaseTable<Mask, Mode>::length>
+    PhaseTable<Mask, Mode>::_ccw;
+
+template <unsigned Mask, DriveMode Mode>
+constexpr phase::SetResetPhases<PhaseTable<Mask, Mode>::length>
+    PhaseTable<Mask, Mode>::_cwSetReset;
+
+template <unsigned Mask, DriveMode Mode>
+constexpr phase::SetResetPhases<PhaseTable<Mask, Mode>::length>
+    PhaseTable<Mask, Mode>::_ccwSetReset;
+
+#endif
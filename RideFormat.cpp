@@ -0,0 +1,78 @@
+#include "RideFormat.h"
+
+#include <stddef.h>
+
+namespace rideformat {
+
+namespace {
+
+struct CrcTable {
+  uint32_t entry[256];
+};
+
+// Reflected CRC-32, polynomial 0x04c11db7
+constexpr CrcTable makeCrcTable() {
+  CrcTable table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++)
+      crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+    table.entry[i] = crc;
+  }
+  return table;
+}
+
+constexpr CrcTable crcTable = makeCrcTable();
+
+} // namespace
+
+uint32_t crc32(const void *data, uint32_t length, uint32_t crc) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  while (length--)
+    crc = (crc >> 8) ^ crcTable.entry[(crc ^ *bytes++) & 0xff];
+  return ~crc;
+}
+
+const char *check(const void *image, uint32_t size, uint16_t stop) {
+  const Header *header = (const Header *)image;
+  if (size < sizeof(Header) || header->magic != MAGIC)
+    return "no ride image";
+  if (header->version != VERSION)
+    return "unknown version";
+  if (header->rides == 0)
+    return "no rides";
+  if (header->length > size - sizeof(Header) ||
+      header->length > MAX_SIZE - sizeof(Header))
+    return "too long";
+  uint32_t directory = header->rides * sizeof(Entry);
+  if (directory > header->length ||
+      (header->length - directory) % sizeof(RideSegment) != 0)
+    return "bad length";
+  if (crc32(header + 1, header->length) != header->crc)
+    return "bad crc";
+  uint32_t count = (header->length - directory) / sizeof(RideSegment);
+  const RideSegment *segment = segments(image);
+  for (uint32_t i = 0; i < count; i++) {
+    if (segment[i].ramp > RIDE_RAMP || segment[i].reserved != 0 ||
+        segment[i].text[sizeof(segment[i].text) - 1] != 0)
+      return "bad segment";
+  }
+  const Entry *entry = entries(image);
+  for (uint16_t ride = 0; ride < header->rides; ride++) {
+    uint16_t first = entry[ride].first;
+    if (first > count || entry[ride].count > count - first)
+      return "bad ride";
+    if (entry[ride].count == 0)
+      return "empty ride";
+    if (segment[first + entry[ride].count - 1].speed != stop)
+      return "ride does not stop";
+    for (uint16_t i = first + 1; i < first + entry[ride].count; i++) {
+      if (segment[i].offsetMs < segment[i - 1].offsetMs)
+        return "segments out of order";
+    }
+  }
+  return NULL;
+}
+
+} // namespace rideformat
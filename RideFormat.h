@@ -0,0 +1,109 @@
+#ifndef RIDE_FORMAT_H
+#define RIDE_FORMAT_H
+
+#include <stdint.h>
+
+#include <chrono>
+
+/* Ride segments and the binary ride image they are stored in. The segment
+ * layout is the same in flash, in the data EEPROM and in RAM, so the
+ * controller plays a stored image in place. Only needs the C++ library, the
+ * host tool in sim/ uses it as well.
+ */
+
+/** How a ride segment gets to its speed */
+enum RideRamp {
+  RIDE_JUMP, ///< Set the speed at once
+  RIDE_RAMP  ///< Ramp there along the motion profile
+};
+
+/** One entry of a ride program, 28 bytes little endian */
+struct RideSegment {
+  uint32_t offsetMs; ///< Time from the start of the ride in ms
+  uint16_t speed;    ///< Target speed in half steps/s
+  uint8_t ramp;      ///< RideRamp, how to reach the speed
+  uint8_t reserved;  ///< 0
+  char text[20];     ///< Text for display row 0, NUL terminated, "" for none
+
+  /** Time from the start of the ride */
+  std::chrono::milliseconds offset() const {
+    return std::chrono::milliseconds(offsetMs);
+  }
+};
+
+static_assert(sizeof(RideSegment) == 28, "RideSegment is a storage format");
+
+/** Segment for a ride table
+ * @param offset Time from the start of the ride
+ * @param speed Target speed in half steps/s
+ * @param ramp How to reach the speed
+ * @param text Text for display row 0, at most 16 characters, "" for none
+ */
+constexpr RideSegment rideSegment(std::chrono::milliseconds offset,
+                                  uint16_t speed, RideRamp ramp,
+                                  const char *text = "") {
+  RideSegment segment{(uint32_t)offset.count(), speed, (uint8_t)ramp, 0, {}};
+  for (unsigned i = 0; i < sizeof(segment.text) - 1 && text[i]; i++)
+    segment.text[i] = text[i];
+  return segment;
+}
+
+namespace rideformat {
+
+/* An image is the header, one Entry per ride and the segments of all rides.
+ * The CRC covers everything after the header.
+ */
+
+const uint32_t MAGIC = 0x45444952; // "RIDE"
+const uint16_t VERSION = 1;
+
+/** Largest image, keeps checking it at boot well under 1 ms */
+const uint32_t MAX_SIZE = 2048;
+
+struct Header {
+  uint32_t magic;   ///< MAGIC
+  uint16_t version; ///< VERSION
+  uint16_t rides;   ///< Number of Entry records
+  uint32_t length;  ///< Bytes after the header
+  uint32_t crc;     ///< CRC-32 of the bytes after the header
+};
+
+struct Entry {
+  uint16_t first; ///< Index of the first segment
+  uint16_t count; ///< Number of segments
+};
+
+static_assert(sizeof(Header) == 16 && sizeof(Entry) == 4,
+              "the image layout is fixed");
+
+/** CRC-32 as used by zlib and Ethernet
+ * @param data Bytes to check
+ * @param length Number of bytes
+ * @param crc CRC of the preceding bytes, to continue a calculation
+ */
+uint32_t crc32(const void *data, uint32_t length, uint32_t crc = 0);
+
+/** Check an image: header, CRC, ride ranges and segments. An image has
+ * rides, every ride has segments and its last segment stops the motor, so a
+ * ride always ends.
+ * @param image Image, 4 byte aligned
+ * @param size Bytes available at image
+ * @param stop Speed at which the motor stops in half steps/s
+ * @return NULL if the image is valid, else what is wrong
+ */
+const char *check(const void *image, uint32_t size, uint16_t stop);
+
+/** Ride directory of a checked image */
+inline const Entry *entries(const void *image) {
+  return (const Entry *)((const uint8_t *)image + sizeof(Header));
+}
+
+/** Segments of a checked image */
+inline const RideSegment *segments(const void *image) {
+  const Header *header = (const Header *)image;
+  return (const RideSegment *)(entries(image) + header->rides);
+}
+
+} // namespace rideformat
+
+#endif
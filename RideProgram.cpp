@@ -0,0 +1,44 @@
+#include "RideProgram.h"
+
+RideRunner::RideRunner(EventScheduler &scheduler,
+                       Callback<void(const RideSegment &)> apply)
+    : _scheduler(scheduler), _apply(apply), _program{NULL, 0}, _next(0) {}
+
+void RideRunner::start(const RideProgram &program) {
+  _scheduler.cancel(_event);
+  _program = program;
+  _next = 0;
+  _start = TickerDataClock::now();
+  next();
+}
+
+void RideRunner::cancel() { _scheduler.cancel(_event); }
+
+std::chrono::milliseconds RideRunner::length() const {
+  if (_program.count == 0)
+    return std::chrono::milliseconds(0);
+  return _program.segments[_program.count - 1].offset();
+}
+
+std::chrono::milliseconds RideRunner::remaining() const {
+  if (!active())
+    return std::chrono::milliseconds(0);
+  std::chrono::milliseconds left =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          _start + length() - TickerDataClock::now());
+  return left.count() > 0 ? left : std::chrono::milliseconds(0);
+}
+
+// Apply every segment that is due and post the event for the next one
+void RideRunner::next() {
+  while (_next < _program.count) {
+    const RideSegment &segment = _program.segments[_next];
+    EventScheduler::time_point due = _start + segment.offset();
+    if (due > TickerDataClock::now()) {
+      _scheduler.postAt(_event, callback(this, &RideRunner::next), due);
+      return;
+    }
+    _next++;
+    _apply(segment);
+  }
+}
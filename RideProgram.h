@@ -0,0 +1,76 @@
+#ifndef RIDE_PROGRAM_H
+#define RIDE_PROGRAM_H
+
+#include "mbed.h"
+
+#include "EventScheduler.h"
+#include "RideFormat.h"
+
+/** A ride as a constant table of segments ordered by offset */
+struct RideProgram {
+  const RideSegment *segments;
+  uint16_t count;
+};
+
+/** Ride program from a segment array */
+template <size_t N>
+constexpr RideProgram rideProgram(const RideSegment (&segments)[N]) {
+  return RideProgram{segments, (uint16_t)N};
+}
+
+/** Plays a ride program on an EventScheduler.
+ *
+ * Only the next segment is posted, so a ride uses one scheduler event no
+ * matter how many segments it has, and cancel() is constant time. The
+ * segments are timed from the start of the ride, so late segments do not
+ * delay the following ones.
+ *
+ * Example:
+ * @code
+ * constexpr RideSegment kids[] = {rideSegment(0s, 50, RIDE_JUMP, "Kids"),
+ *                                 rideSegment(30s, 100, RIDE_RAMP),
+ *                                 rideSegment(180s, 0, RIDE_RAMP)};
+ * RideRunner ride(scheduler, callback(&applySegment));
+ * ride.start(rideProgram(kids));
+ * @endcode
+ */
+class RideRunner {
+public:
+  /** Create a runner
+   * @param scheduler Scheduler the segments are posted to
+   * @param apply Called with every segment when it is due, from start() or
+   *              interrupt context
+   */
+  RideRunner(EventScheduler &scheduler,
+             Callback<void(const RideSegment &)> apply);
+
+  /** Start a ride, a running ride is replaced. Segments with offset 0 are
+   * applied before start() returns.
+   * @param program Ride program, must stay valid while the ride runs
+   */
+  void start(const RideProgram &program);
+
+  /** Stop the ride, segments not applied yet are dropped */
+  void cancel();
+
+  /** Whether segments are still to be applied */
+  bool active() const { return _event.pending(); }
+
+  /** Time from the start to the last segment of the ride */
+  std::chrono::milliseconds length() const;
+
+  /** Time until the last segment is due, 0 once it was applied */
+  std::chrono::milliseconds remaining() const;
+
+private:
+  void next();
+
+  EventScheduler &_scheduler;
+  EventScheduler::Event _event;
+  Callback<void(const RideSegment &)> _apply;
+  RideProgram _program;
+  uint16_t _next;
+  EventScheduler::time_point _start;
+};
+
+#endif
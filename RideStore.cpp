@@ -0,0 +1,100 @@
+#include "RideStore.h"
+
+#include "Delay.h"
+
+#if defined(DATA_EEPROM_BASE)
+#define RIDE_STORE_BASE ((const uint32_t *)DATA_EEPROM_BASE)
+#define RIDE_STORE_SIZE (DATA_EEPROM_END - DATA_EEPROM_BASE + 1)
+
+namespace {
+
+// Program a word of the data EEPROM, unchanged words are skipped to save
+// time and wear
+bool program(uint32_t index, uint32_t word) {
+  return RIDE_STORE_BASE[index] == word ||
+         HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD,
+                                        DATA_EEPROM_BASE + 4 * index,
+                                        word) == HAL_OK;
+}
+
+} // namespace
+#endif
+
+RideStore::RideStore(uint16_t stop, Callback<bool(const RideSegment &)> valid)
+    : _stop(stop), _valid(valid), _image(NULL), _rides(0), _error(NULL),
+      _loadCycles(0) {}
+
+bool RideStore::load() {
+  uint32_t start = Delay::cycles();
+  _rides = 0;
+#if defined(DATA_EEPROM_BASE)
+  uint32_t size = RIDE_STORE_SIZE;
+  _error = check(RIDE_STORE_BASE,
+                 size < rideformat::MAX_SIZE ? size : rideformat::MAX_SIZE);
+  if (!_error) {
+    _image = RIDE_STORE_BASE;
+    _rides = ((const rideformat::Header *)_image)->rides;
+  }
+#else
+  _error = "no data EEPROM";
+#endif
+  _loadCycles = Delay::cycles() - start;
+  return !_error;
+}
+
+RideProgram RideStore::ride(uint16_t index) const {
+  const rideformat::Entry &entry = rideformat::entries(_image)[index];
+  return RideProgram{rideformat::segments(_image) + entry.first, entry.count};
+}
+
+uint32_t RideStore::loadUs() const {
+  return _loadCycles / Delay::nsToCycles(1000);
+}
+
+bool RideStore::write(const void *image, uint32_t size) {
+  _error = check(image, size);
+  if (_error)
+    return false;
+#if defined(DATA_EEPROM_BASE)
+  if (size > RIDE_STORE_SIZE) {
+    _error = "too long";
+    return false;
+  }
+  _rides = 0;
+  const uint32_t *words = (const uint32_t *)image;
+  const uint32_t header = sizeof(rideformat::Header) / 4;
+  HAL_FLASHEx_DATAEEPROM_Unlock();
+  // Invalidate the magic first and write the header last, down to the
+  // magic, so only a complete image is valid
+  bool ok = program(0, 0);
+  for (uint32_t i = header; ok && i < size / 4; i++)
+    ok = program(i, words[i]);
+  for (uint32_t i = header; ok && i-- > 0;)
+    ok = program(i, words[i]);
+  HAL_FLASHEx_DATAEEPROM_Lock();
+  if (!ok) {
+    _error = "write failed";
+    return false;
+  }
+  return load();
+#else
+  _error = "no data EEPROM";
+  return false;
+#endif
+}
+
+// Format check of rideformat and the segment check of the controller
+const char *RideStore::check(const void *image, uint32_t size) {
+  const char *error = rideformat::check(image, size, _stop);
+  if (error || !_valid)
+    return error;
+  const rideformat::Header *header = (const rideformat::Header *)image;
+  uint32_t directory = header->rides * sizeof(rideformat::Entry);
+  uint32_t count = (header->length - directory) / sizeof(RideSegment);
+  const RideSegment *segment = rideformat::segments(image);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!_valid(segment[i]))
+      return "bad segment";
+  }
+  return NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef RIDE_STORE_H
+#define RIDE_STORE_H
+
+#include "mbed.h"
+
+#include "RideFormat.h"
+#include "RideProgram.h"
+
+/** Ride programs stored in the data EEPROM.
+ *
+ * The data EEPROM is memory mapped, so load() only checks the image and the
+ * rides are played from the EEPROM in place. The check is bounded by
+ * rideformat::MAX_SIZE and its time is measured with the cycle counter.
+ *
+ * write() programs a new image word by word, about 3 ms per changed word.
+ * The magic goes first and the header last, so an interrupted write leaves
+ * no valid image behind. The flash may stall while the EEPROM is written,
+ * so only write while no ride runs.
+ *
+ * Example:
+ * @code
+ * RideStore store(40);
+ * if (store.load())
+ *   ride.start(store.ride(0));
+ * @endcode
+ */
+class RideStore {
+public:
+  /** Create the store
+   * @param stop Speed at which the motor stops, the last segment of every
+   *             ride must have it
+   * @param valid Further check of every segment of an image, e.g. of the
+   *              speeds, or nullptr
+   */
+  RideStore(uint16_t stop,
+            Callback<bool(const RideSegment &)> valid = nullptr);
+
+  /** Check the image in the data EEPROM, call at boot
+   * @return Whether a valid image was found
+   */
+  bool load();
+
+  /** Number of rides in the image, 0 without a valid image */
+  uint16_t rides() const { return _rides; }
+
+  /** Ride of the image
+   * @param index Ride index, less than rides()
+   */
+  RideProgram ride(uint16_t index) const;
+
+  /** Why the last load() or write() failed, NULL if it did not */
+  const char *error() const { return _error; }
+
+  /** Time the last load() took in us */
+  uint32_t loadUs() const;
+
+  /** Check an image, program it into the data EEPROM and load it. Only from
+   * a thread, this takes up to seconds.
+   * @param image Image, 4 byte aligned
+   * @param size Length of the image in bytes
+   * @return Whether the image was stored, see error() if not
+   */
+  bool write(const void *image, uint32_t size);
+
+private:
+  const char *check(const void *image, uint32_t size);
+
+  uint16_t _stop;
+  Callback<bool(const RideSegment &)> _valid;
+  const void *volatile _image;
+  uint16_t volatile _rides;
+  const char *_error;
+  uint32_t _loadCycles;
+};
+
+#endif
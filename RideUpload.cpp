@@ -0,0 +1,95 @@
+#include "RideUpload.h"
+
+// Waits on the serial port and formats short replies
+#define UPLOAD_STACK_SIZE 1536
+
+RideUpload::RideUpload(RideStore &store, Callback<bool()> idle, PinName tx,
+                       PinName rx, int baud)
+    : _store(store), _idle(idle), _commandCount(0), _serial(tx, rx, baud),
+      _thread(osPriorityLow, UPLOAD_STACK_SIZE, NULL, "upload"),
+      _load("upload"), _writing(false) {}
+
+bool RideUpload::onCommand(
+    char command, Callback<void(Callback<void(const char *)>)> handler) {
+  if (_commandCount == MAX_COMMANDS)
+    return false;
+  _commands[_commandCount] = command;
+  _handlers[_commandCount] = handler;
+  _commandCount++;
+  return true;
+}
+
+void RideUpload::start() { _thread.start(callback(this, &RideUpload::run)); }
+
+void RideUpload::run() {
+  _load.busy();
+  report(NULL);
+  rideformat::Header *header = (rideformat::Header *)_image;
+  while (true) {
+    // Resynchronise on the magic, whatever came before
+    uint32_t magic = 0;
+    while (magic != rideformat::MAGIC) {
+      uint8_t byte;
+      receive(&byte, 1);
+      command(byte);
+      magic = (magic >> 8) | (uint32_t)byte << 24;
+    }
+    header->magic = magic;
+    receive(&header->version, sizeof(*header) - sizeof(header->magic));
+    if (header->length > sizeof(_image) - sizeof(*header)) {
+      report("too long");
+      continue;
+    }
+    receive(header + 1, header->length);
+    // A ride starting from now on waits for us, one that runs stops us
+    _writing = true;
+    const char *error = NULL;
+    if (!_idle())
+      error = "ride running";
+    else if (!_store.write(_image, sizeof(*header) + header->length))
+      error = _store.error();
+    _writing = false;
+    report(error);
+  }
+}
+
+// Run the command bound to a character, if any
+void RideUpload::command(char byte) {
+  for (uint8_t i = 0; i < _commandCount; i++) {
+    if (_commands[i] == byte)
+      _handlers[i](callback(this, &RideUpload::print));
+  }
+}
+
+// Read exactly length bytes
+void RideUpload::receive(void *buffer, uint32_t length) {
+  uint8_t *bytes = (uint8_t *)buffer;
+  while (length > 0) {
+    _load.idle();
+    ssize_t count = _serial.read(bytes, length);
+    _load.busy();
+    if (count > 0) {
+      bytes += count;
+      length -= count;
+    }
+  }
+}
+
+// Send why an upload failed, or the state of the store
+void RideUpload::report(const char *error) {
+  char line[64];
+  if (error)
+    snprintf(line, sizeof(line), "ERR %s", error);
+  else if (_store.rides())
+    snprintf(line, sizeof(line), "OK %u rides, checked in %luus",
+             (unsigned)_store.rides(), (unsigned long)_store.loadUs());
+  else
+    snprintf(line, sizeof(line), "OK built-in rides, %s",
+             _store.error() ? _store.error() : "no rides");
+  print(line);
+}
+
+void RideUpload::print(const char *line) {
+  _serial.write(line, strlen(line));
+  _serial.write("\r\n", 2);
+}
@@ -0,0 +1,85 @@
+#ifndef RIDE_UPLOAD_H
+#define RIDE_UPLOAD_H
+
+#include "mbed.h"
+
+#include "RideStore.h"
+#include "ThreadLoad.h"
+
+/** Receives ride images over the serial port and stores them.
+ *
+ * A low priority thread waits for the magic of an image, reads the header
+ * and the rest of the image into RAM, and writes it to the RideStore if it
+ * is valid and no ride runs. Every image is answered with a line, "OK ..."
+ * or "ERR <reason>". The images are self delimiting, so they can be sent
+ * with any terminal program, e.g. cat rides.bin > /dev/ttyACM0.
+ *
+ * Single characters outside of an image can be bound to commands that
+ * answer with lines, e.g. '?' for a status report.
+ *
+ * Example:
+ * @code
+ * bool rideIdle() { return !_rotate; }
+ * RideUpload upload(store, callback(&rideIdle));
+ * upload.start();
+ * @endcode
+ */
+class RideUpload {
+public:
+  /** Most command characters that can be bound */
+  static const uint8_t MAX_COMMANDS = 4;
+
+  /** Create the upload
+   * @param store Store the images are written to
+   * @param idle Whether no ride runs, called before writing
+   * @param tx Serial transmit pin
+   * @param rx Serial receive pin
+   * @param baud Baud rate
+   */
+  RideUpload(RideStore &store, Callback<bool()> idle, PinName tx = USBTX,
+             PinName rx = USBRX, int baud = 115200);
+
+  /** Bind a command character, before start()
+   * @param command Character that runs the command
+   * @param handler Sends its answer through the print function it is given
+   * @return false if MAX_COMMANDS are bound already
+   */
+  bool onCommand(char command,
+                 Callback<void(Callback<void(const char *)>)> handler);
+
+  /** Send a line to the host, also from other threads
+   * @param line Line without line end
+   */
+  void print(const char *line);
+
+  /** Report the state of the store and start receiving */
+  void start();
+
+  /** Switch the receiver of the serial port, only from a thread. The
+   * receiver keeps the controller out of deep sleep while it is on.
+   * @param enabled Whether to receive, images sent meanwhile are lost
+   */
+  void listen(bool enabled) { _serial.enable_input(enabled); }
+
+  /** Whether the store is being written, no ride may start meanwhile */
+  bool writing() const { return _writing; }
+
+private:
+  void run();
+  void receive(void *buffer, uint32_t length);
+  void report(const char *error);
+  void command(char byte);
+
+  RideStore &_store;
+  Callback<bool()> _idle;
+  char _commands[MAX_COMMANDS];
+  Callback<void(Callback<void(const char *)>)> _handlers[MAX_COMMANDS];
+  uint8_t _commandCount;
+  BufferedSerial _serial;
+  Thread _thread;
+  ThreadLoad _load;
+  bool volatile _writing;
+  uint32_t _image[rideformat::MAX_SIZE / 4];
+};
+
+#endif
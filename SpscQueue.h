@@ -0,0 +1,77 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+/** Lock-free ring buffer for one producer and one consumer.
+ *
+ * push() and pop() take constant time and never block, so the producer can
+ * be an interrupt and the consumer a thread. Each index is only written by
+ * one side. Several producers must not run push() at the same time: a
+ * producer that preempts another one corrupts the queue. Keep them out of
+ * each other with a lock around push(), as Mailbox does, or only push from
+ * interrupts of one priority.
+ *
+ * @tparam T Element type, copied in and out
+ * @tparam Size Number of slots, a power of two up to 32768
+ */
+template <typename T, uint16_t Size> class SpscQueue {
+  static_assert(Size > 0 && (Size & (Size - 1)) == 0,
+                "queue size must be a power of two");
+  static_assert(Size <= 0x8000, "queue size must fit the 16 bit indices");
+
+public:
+  SpscQueue() : _head(0), _tail(0), _maxDepth(0), _dropped(0) {}
+
+  /** Append an element, producer side
+   * @return false if the queue was full, the element is dropped then
+   */
+  bool push(const T &item) {
+    uint16_t head = _head.load(std::memory_order_relaxed);
+    uint16_t depth = head - _tail.load(std::memory_order_acquire);
+    if (depth == Size) {
+      _dropped++;
+      return false;
+    }
+    _items[head % Size] = item;
+    _head.store(head + 1, std::memory_order_release);
+    if (depth + 1 > _maxDepth)
+      _maxDepth = depth + 1;
+    return true;
+  }
+
+  /** Take the oldest element, consumer side
+   * @return false if the queue was empty
+   */
+  bool pop(T &item) {
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire))
+      return false;
+    item = _items[tail % Size];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Number of elements waiting */
+  uint16_t depth() const {
+    return _head.load(std::memory_order_acquire) -
+           _tail.load(std::memory_order_acquire);
+  }
+
+  /** Highest number of elements waiting at once */
+  uint16_t maxDepth() const { return _maxDepth; }
+
+  /** Number of elements dropped because the queue was full */
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  T _items[Size];
+  std::atomic<uint16_t> _head; // written by the producer
+  std::atomic<uint16_t> _tail; // written by the consumer
+  uint16_t volatile _maxDepth;
+  uint32_t volatile _dropped;
+};
+
+#endif
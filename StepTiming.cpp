@@ -0,0 +1,135 @@
+#include "StepTiming.h"
+
+#include "Delay.h"
+#include "IrqLock.h"
+
+// Version of the report format
+#define REPORT_VERSION 2
+
+// Bin widths: interval errors are interrupt latencies of a few us, button
+// latencies include the debouncing, the emergency stop takes well below 1 us
+#define BIN_ERROR_NS 250
+#define BIN_BUTTON_NS 1000000
+#define BIN_EMERGENCY_NS 50
+
+namespace {
+
+const char *const inputNames[TIMING_INPUTS] = {"onoff", "rotate",
+                                               "emergency"};
+
+void clear(TimingHistogram &histogram, uint32_t binNs) {
+  memset(&histogram, 0, sizeof(histogram));
+  histogram.binNs = binNs;
+}
+
+} // namespace
+
+void TimingHistogram::add(uint32_t ns) {
+  uint32_t bin = ns / binNs;
+  bins[bin < BINS ? bin : BINS - 1]++;
+  if (ns > maxNs)
+    maxNs = ns;
+  count++;
+}
+
+uint32_t TimingHistogram::percentile(uint32_t permille) const {
+  uint32_t rank = ((uint64_t)count * permille + 999) / 1000;
+  uint32_t sum = 0;
+  for (uint8_t bin = 0; bin < BINS - 1; bin++) {
+    sum += bins[bin];
+    if (sum >= rank)
+      return (bin + 1) * binNs < maxNs ? (bin + 1) * binNs : maxNs;
+  }
+  return maxNs;
+}
+
+StepTiming::StepTiming()
+    : _cyclesPerUs(0), _levels(0), _pending(0), _last(0), _restart(true) {
+  for (uint8_t i = 0; i <= MAX_LEVELS; i++)
+    clear(_errors[i], BIN_ERROR_NS);
+  clear(_latencies[TIMING_ON_OFF], BIN_BUTTON_NS);
+  clear(_latencies[TIMING_ROTATE], BIN_BUTTON_NS);
+  clear(_latencies[TIMING_EMERGENCY], BIN_EMERGENCY_NS);
+}
+
+void StepTiming::addLevel(uint32_t speed, uint16_t index) {
+  // calibrate here, not in the step interrupt
+  _cyclesPerUs = Delay::nsToCycles(1000);
+  if (_levels == MAX_LEVELS)
+    return;
+  _speeds[_levels] = speed;
+  _indices[_levels] = index;
+  _levels++;
+}
+
+uint32_t StepTiming::toNs(uint32_t cycles) const {
+  return _cyclesPerUs ? (uint64_t)cycles * 1000 / _cyclesPerUs : 0;
+}
+
+void StepTiming::step(uint32_t cycles, uint32_t intervalUs, uint16_t index) {
+  if (_restart) {
+    _restart = false;
+    _last = cycles;
+    reaction(TIMING_ROTATE, cycles);
+    return;
+  }
+  int32_t error = (int32_t)(cycles - _last - intervalUs * _cyclesPerUs);
+  _last = cycles;
+  uint8_t level = 0;
+  while (level < _levels && _indices[level] != index)
+    level++;
+  _errors[level].add(toNs(error < 0 ? -error : error));
+}
+
+void StepTiming::input(TimingInput input, uint32_t cycles) {
+  _inputs[input] = cycles;
+  _pending |= 1u << input;
+}
+
+void StepTiming::reaction(TimingInput input, uint32_t cycles) {
+  IrqLock lock;
+  if (!(_pending & 1u << input))
+    return;
+  _pending &= ~(1u << input);
+  _latencies[input].add(toNs(cycles - _inputs[input]));
+}
+
+void StepTiming::latency(TimingInput input, uint32_t ns) {
+  IrqLock lock;
+  _latencies[input].add(ns);
+}
+
+void StepTiming::report(Callback<void(const char *)> print,
+                        unsigned axis) const {
+  char line[96];
+  snprintf(line, sizeof(line), "STEPTIMING %u axis=%u", REPORT_VERSION, axis);
+  print(line);
+  for (uint8_t i = 0; i <= _levels; i++) {
+    const TimingHistogram &errors = _errors[i];
+    if (errors.count == 0)
+      continue;
+    char speed[12] = "ramp";
+    if (i < _levels)
+      snprintf(speed, sizeof(speed), "%lu", (unsigned long)_speeds[i]);
+    snprintf(line, sizeof(line),
+             "interval speed=%s steps=%lu p50_ns=%lu p99_ns=%lu max_ns=%lu",
+             speed, (unsigned long)errors.count,
+             (unsigned long)errors.percentile(500),
+             (unsigned long)errors.percentile(990),
+             (unsigned long)errors.maxNs);
+    print(line);
+  }
+  for (uint8_t i = 0; i < TIMING_INPUTS; i++) {
+    const TimingHistogram &latencies = _latencies[i];
+    if (latencies.count == 0)
+      continue;
+    snprintf(line, sizeof(line),
+             "latency input=%s count=%lu p50_ns=%lu p99_ns=%lu max_ns=%lu",
+             inputNames[i], (unsigned long)latencies.count,
+             (unsigned long)latencies.percentile(500),
+             (unsigned long)latencies.percentile(990),
+             (unsigned long)latencies.maxNs);
+    print(line);
+  }
+  print("END");
+}
@@ -0,0 +1,122 @@
+#ifndef STEP_TIMING_H
+#define STEP_TIMING_H
+
+#include "mbed.h"
+
+/** Inputs whose time to a reaction is measured */
+enum TimingInput {
+  TIMING_ON_OFF,    ///< edge of on/off to the transition
+  TIMING_ROTATE,    ///< edge of rotate to the first step
+  TIMING_EMERGENCY, ///< emergency interrupt to the coils off
+  TIMING_INPUTS
+};
+
+/** Distribution of durations in bins of fixed width. Percentiles are the
+ * upper edge of their bin, beyond the last bin the maximum. */
+struct TimingHistogram {
+  static const uint8_t BINS = 64;
+
+  uint32_t binNs;
+  uint32_t count;
+  uint32_t maxNs;
+  uint32_t bins[BINS];
+
+  /** Add a sample */
+  void add(uint32_t ns);
+
+  /** Duration that permille of the samples do not exceed */
+  uint32_t percentile(uint32_t permille) const;
+};
+
+/** How precisely the motor is stepped, measured on the running controller.
+ *
+ * The step interrupt passes the cycle count at every coil store. The
+ * difference to the previous store, minus the step interval that was
+ * scheduled, is the interval error. The errors are kept per speed level,
+ * told by the profile index the stepper passes with every step, steps of
+ * the ramps in between count as "ramp". Besides, the time from
+ * an input edge to the reaction of the controller is measured.
+ *
+ * report() sends the percentiles as key=value lines between "STEPTIMING"
+ * and "END", the same on the target and in the host benchmark
+ * sim/bench/step_bench, which checks them against limits. Each motor has
+ * its own StepTiming, so the report of several motors shows how their
+ * shared step timer holds up.
+ *
+ * Example:
+ * @code
+ * StepTiming timing;
+ * timing.addLevel(50, RideProfile::index(50));
+ * stepper.measure(&timing);
+ * timing.report(print, 1);
+ * @endcode
+ */
+class StepTiming {
+public:
+  /** Most speed levels */
+  static const uint8_t MAX_LEVELS = 8;
+
+  /** Profile index of a step without a profile, counts as "ramp" */
+  static const uint16_t NO_INDEX = 0xffff;
+
+  StepTiming();
+
+  /** Keep the interval errors of a speed level apart, from a thread before
+   * the stepper starts
+   * @param speed Speed for the report
+   * @param index Profile index of the speed
+   */
+  void addLevel(uint32_t speed, uint16_t index);
+
+  /** The next step has no interval before it, e.g. after a start */
+  void restart() { _restart = true; }
+
+  /** A step was output, from the step interrupt
+   * @param cycles Cycle count of the coil store
+   * @param intervalUs Interval that was scheduled since the previous step
+   * @param index Profile index the interval was taken from, or NO_INDEX
+   */
+  void step(uint32_t cycles, uint32_t intervalUs, uint16_t index);
+
+  /** An input changed, its reaction comes later
+   * @param input Which input
+   * @param cycles Cycle count of the edge
+   */
+  void input(TimingInput input, uint32_t cycles);
+
+  /** The controller reacted to an input, ignored if the input is not
+   * pending
+   * @param input Which input
+   * @param cycles Cycle count of the reaction
+   */
+  void reaction(TimingInput input, uint32_t cycles);
+
+  /** Add a latency measured elsewhere
+   * @param input Which input
+   * @param ns Time to the reaction
+   */
+  void latency(TimingInput input, uint32_t ns);
+
+  /** Send the report, one line at a time, from a thread
+   * @param print Called for every line, without line end
+   * @param axis Number of the motor for the header
+   */
+  void report(Callback<void(const char *)> print, unsigned axis) const;
+
+private:
+  uint32_t toNs(uint32_t cycles) const;
+
+  uint32_t _cyclesPerUs;
+  uint32_t _speeds[MAX_LEVELS];
+  uint16_t _indices[MAX_LEVELS];
+  uint8_t _levels;
+  // one per level and one for the ramps
+  TimingHistogram _errors[MAX_LEVELS + 1];
+  TimingHistogram _latencies[TIMING_INPUTS];
+  uint32_t _inputs[TIMING_INPUTS];
+  uint32_t volatile _pending; // a bit per input
+  uint32_t _last;
+  bool volatile _restart;
+};
+
+#endif
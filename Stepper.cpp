@@ -0,0 +1,124 @@
+#include "Stepper.h"
+
+#include "Delay.h"
+#include "IrqLock.h"
+#include "Profile.h"
+#include "StepTiming.h"
+#include "Trace.h"
+
+PROFILE_SITE(stepSite, "stepper step");
+
+Stepper::Stepper(EventScheduler &scheduler, GpioBits coils,
+                 const uint32_t *phases, uint8_t phaseCount)
+    : _scheduler(scheduler), _coils(coils), _phases(phases),
+      _phaseCount(phaseCount), _phase(0), _interval(0), _profile(NULL),
+      _index(0), _target(0), _timing(NULL), _steps(0), _running(false),
+      _frozen(false) {}
+
+void Stepper::setStepInterval(std::chrono::microseconds interval) {
+  _interval = interval.count();
+}
+
+void Stepper::setPhases(const uint32_t *phases, uint8_t phaseCount) {
+  _phases = phases;
+  _phaseCount = phaseCount;
+  _phase = 0;
+}
+
+void Stepper::setProfile(const uint32_t *intervals) {
+  _profile = intervals;
+  setSpeedIndex(0);
+}
+
+void Stepper::setSpeedIndex(uint16_t index) {
+  Trace::log(TRACE_SPEED, 1, index);
+  // the step after a jump is scheduled with the old interval
+  if (_timing)
+    _timing->restart();
+  // a step must not move _index towards the old target between the stores
+  // or finish that ramp as well, the jump finishes it once
+  IrqLock lock;
+  _index = index;
+  _target = index;
+  if (_profile)
+    _interval = _profile[index];
+  reached();
+}
+
+void Stepper::rampTo(uint16_t index) {
+  Trace::log(TRACE_SPEED, 0, index);
+  bool there;
+  {
+    // a step must not reach the target between setting and comparing it,
+    // or the ramp would be done twice
+    IrqLock lock;
+    _target = index;
+    there = _index == index;
+  }
+  if (there)
+    reached();
+}
+
+void Stepper::start() {
+  if (_running || _frozen)
+    return;
+  _running = true;
+  if (_timing)
+    _timing->restart();
+  _due = TickerDataClock::now();
+  _scheduler.postAt(_event, callback(this, &Stepper::step), _due);
+}
+
+void Stepper::stop() {
+  _running = false;
+  _scheduler.cancel(_event);
+  _coils.write(0);
+}
+
+void Stepper::freeze() {
+  _coils.write(0);
+  _frozen = true;
+  _running = false;
+}
+
+// Runs in interrupt context: output the next phase, advance the ramp by one
+// table entry and schedule the next step relative to this one, so interrupt
+// latency does not add up
+void Stepper::step() {
+  PROFILE_SCOPE(stepSite);
+  if (!_running)
+    return;
+  _coils.store(_phases[_phase]);
+  if (_timing)
+    _timing->step(Delay::cycles(), _interval,
+                  _profile ? _index : StepTiming::NO_INDEX);
+  // freeze() may have run between the check and the store
+  if (_frozen) {
+    _coils.write(0);
+    return;
+  }
+  if (++_phase == _phaseCount)
+    _phase = 0;
+  _steps++;
+  bool done = false;
+  if (_profile) {
+    uint16_t index = _index;
+    uint16_t target = _target;
+    if (index != target) {
+      index < target ? index++ : index--;
+      done = index == target;
+    }
+    _index = index;
+    _interval = _profile[index];
+  }
+  _due += std::chrono::microseconds(_interval);
+  _scheduler.postAt(_event, callback(this, &Stepper::step), _due);
+  if (done)
+    reached();
+}
+
+void Stepper::reached() {
+  Trace::log(TRACE_RAMP_DONE, 0, _index);
+  if (_rampDone)
+    _rampDone();
+}
@@ -0,0 +1,135 @@
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include "mbed.h"
+
+#include "EventScheduler.h"
+#include "GpioOut.h"
+
+class StepTiming;
+
+/** Interrupt driven step generator for a stepper motor on GPIO bits.
+ *
+ * Every step is an event of an EventScheduler, posted relative to the
+ * previous step, so the step rate has microsecond resolution, does not
+ * drift and keeps running independently of the main thread. Several
+ * steppers share one scheduler and so one timer: the scheduler always arms
+ * the earliest step of all motors. Steps that are due at the same time run
+ * one after the other. The phases are BSRR words, so every coil update is
+ * a single store that leaves the other bits of the port alone.
+ *
+ * Example:
+ * @code
+ * EventScheduler steps;
+ * GpioOut<PortC, 0xf00> motor;
+ * typedef PhaseTable<0xf00, DRIVE_FULL_STEP> Phases;
+ * Stepper stepper(steps, motor.bits(), Phases::cwSetReset(), Phases::length);
+ * stepper.setStepInterval(2500us);
+ * stepper.start();
+ * @endcode
+ */
+class Stepper {
+public:
+  /** Create a step generator
+   * @param scheduler Scheduler the steps are posted to
+   * @param coils Bits of the coils
+   * @param phases Phases as BSRR words for the coils, output in order
+   * @param phaseCount Number of entries in phases
+   */
+  Stepper(EventScheduler &scheduler, GpioBits coils, const uint32_t *phases,
+          uint8_t phaseCount);
+
+  /** Set the time between two steps, takes effect with the next step
+   * @param interval Step interval
+   */
+  void setStepInterval(std::chrono::microseconds interval);
+
+  /** Time between two steps at the moment, changes during ramps */
+  std::chrono::microseconds stepInterval() const {
+    return std::chrono::microseconds(_interval);
+  }
+
+  /** Change the phases, e.g. to reverse the direction, while stopped
+   * @param phases Phases as BSRR words for the coils, output in order
+   * @param phaseCount Number of entries in phases
+   */
+  void setPhases(const uint32_t *phases, uint8_t phaseCount);
+
+  /** Let the step interval follow a table, one entry per step
+   * @param intervals Step intervals in us ordered by increasing speed,
+   *                  e.g. MotionProfile::intervals()
+   */
+  void setProfile(const uint32_t *intervals);
+
+  /** Jump to an entry of the profile without ramping, the ramp is done at
+   * once
+   * @param index Index into the profile
+   */
+  void setSpeedIndex(uint16_t index);
+
+  /** Ramp towards an entry of the profile, moving one entry per step. If
+   * the stepper is at the entry already, the ramp is done at once.
+   * @param index Index into the profile
+   */
+  void rampTo(uint16_t index);
+
+  /** Whether the stepper is still ramping towards its target */
+  bool ramping() const { return _index != _target; }
+
+  /** Call a function from the step interrupt whenever a ramp reaches its
+   * target, or from setSpeedIndex() and rampTo() if there is nothing to
+   * ramp, e.g. to wake a thread instead of polling ramping()
+   * @param func Callback, nullptr for none
+   */
+  void onRampDone(Callback<void()> func) { _rampDone = func; }
+
+  /** Pass the time of every coil store to a recorder, while stopped
+   * @param timing Recorder, NULL for none
+   */
+  void measure(StepTiming *timing) { _timing = timing; }
+
+  /** Start stepping, the first step is output immediately */
+  void start();
+
+  /** Stop stepping and switch off the coils */
+  void stop();
+
+  /** Cut the coils and stop for good, for the emergency stop interrupt.
+   *
+   * Only stores to the port and two flags, so it is safe from an interrupt
+   * that preempts the step interrupt. start() does nothing afterwards.
+   */
+  void freeze();
+
+  /** Whether freeze() was called */
+  bool frozen() const { return _frozen; }
+
+  /** Number of steps output since the stepper was created */
+  uint32_t stepsTaken() const { return _steps; }
+
+  /** Whether the step generator is running */
+  bool running() const { return _running; }
+
+private:
+  void step();
+  void reached();
+
+  EventScheduler &_scheduler;
+  EventScheduler::Event _event;
+  EventScheduler::time_point _due;
+  GpioBits _coils;
+  const uint32_t *_phases;
+  uint8_t _phaseCount;
+  uint8_t _phase;
+  uint32_t volatile _interval; // in us, read from the step interrupt
+  const uint32_t *_profile;
+  uint16_t volatile _index;
+  uint16_t volatile _target;
+  Callback<void()> _rampDone;
+  StepTiming *_timing;
+  uint32_t volatile _steps;
+  bool volatile _running;
+  bool volatile _frozen;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "ThreadLoad.h"
+
+#include "Delay.h"
+#include "mbed_stats.h"
+
+// Threads listed by report(), mbed-os adds the idle and timer threads
+#define REPORT_THREADS 10
+
+ThreadLoad *ThreadLoad::_first = NULL;
+
+ThreadLoad::ThreadLoad(const char *name)
+    : _name(name), _cycles(0), _start(0), _busy(false), _next(_first) {
+  _first = this;
+}
+
+void ThreadLoad::busy() {
+  _start = Delay::cycles();
+  _busy = true;
+}
+
+void ThreadLoad::idle() {
+  if (_busy)
+    _cycles += Delay::cycles() - _start;
+  _busy = false;
+}
+
+ThreadLoad *ThreadLoad::find(const char *name) {
+  for (ThreadLoad *load = _first; load; load = load->_next) {
+    if (name && strcmp(load->_name, name) == 0)
+      return load;
+  }
+  return NULL;
+}
+
+void ThreadLoad::report(Callback<void(const char *)> print) {
+  char line[64];
+  uint64_t uptimeMs = Kernel::Clock::now().time_since_epoch().count();
+  uint64_t uptime = uptimeMs * Delay::nsToCycles(1000000);
+  print("thread       prio  stack used/size   cpu");
+#if MBED_THREAD_STATS_ENABLED
+  mbed_stats_thread_t threads[REPORT_THREADS];
+  size_t count = mbed_stats_thread_get_each(threads, REPORT_THREADS);
+  for (size_t i = 0; i < count; i++) {
+    const mbed_stats_thread_t &thread = threads[i];
+    int length = snprintf(line, sizeof(line), "%-12.12s %4lu %10lu/%-6lu",
+                          thread.name ? thread.name : "?",
+                          (unsigned long)thread.priority,
+                          (unsigned long)(thread.stack_size - thread.stack_space),
+                          (unsigned long)thread.stack_size);
+    ThreadLoad *load = find(thread.name);
+    if (load && uptime) {
+      // in hundredths of a percent
+      uint32_t load100 = load->_cycles * 10000 / uptime;
+      snprintf(line + length, sizeof(line) - length, " %3lu.%02lu%%",
+               (unsigned long)(load100 / 100), (unsigned long)(load100 % 100));
+    } else {
+      snprintf(line + length, sizeof(line) - length, "      -");
+    }
+    print(line);
+  }
+#else
+  for (ThreadLoad *load = _first; load; load = load->_next) {
+    uint32_t load100 = uptime ? load->_cycles * 10000 / uptime : 0;
+    snprintf(line, sizeof(line), "%-12.12s    -          -/-      %3lu.%02lu%%",
+             load->_name, (unsigned long)(load100 / 100),
+             (unsigned long)(load100 % 100));
+    print(line);
+  }
+#endif
+#if MBED_CPU_STATS_ENABLED
+  mbed_stats_cpu_t cpu;
+  mbed_stats_cpu_get(&cpu);
+  if (cpu.uptime) {
+    snprintf(line, sizeof(line), "idle %lu.%02lu%%, deep sleep %lu.%02lu%%",
+             (unsigned long)(cpu.idle_time * 100 / cpu.uptime),
+             (unsigned long)(cpu.idle_time * 10000 / cpu.uptime % 100),
+             (unsigned long)(cpu.deep_sleep_time * 100 / cpu.uptime),
+             (unsigned long)(cpu.deep_sleep_time * 10000 / cpu.uptime % 100));
+    print(line);
+  }
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef THREAD_LOAD_H
+#define THREAD_LOAD_H
+
+#include "mbed.h"
+
+/** CPU load of one thread, measured by the thread itself.
+ *
+ * The thread calls busy() when it wakes up and idle() before it waits
+ * again, the cycles in between are summed up. Interrupts and threads of
+ * higher priority that preempt it meanwhile count as its load too, so the
+ * numbers are upper bounds.
+ *
+ * report() lists every thread of the RTOS with its priority, stack
+ * high-water mark and load, to size the stacks. The stack numbers need
+ * platform.thread-stats-enabled and platform.stack-stats-enabled, the idle
+ * time platform.cpu-stats-enabled in mbed_app.json.
+ *
+ * Example:
+ * @code
+ * ThreadLoad load("display"); // same name as the Thread
+ * void run() {
+ *   while (true) {
+ *     load.idle();
+ *     ThisThread::flags_wait_any(1);
+ *     load.busy();
+ *     ...
+ *   }
+ * }
+ * @endcode
+ */
+class ThreadLoad {
+public:
+  /** Create the meter of a thread, it counts from the first busy()
+   * @param name Name of the thread, the report matches them by it
+   */
+  explicit ThreadLoad(const char *name);
+
+  /** The thread starts working */
+  void busy();
+
+  /** The thread stops working to wait */
+  void idle();
+
+  /** Send the report, one line at a time, from a thread of lowest priority
+   * so it cannot interrupt an update of the meters
+   * @param print Called for every line, without line end
+   */
+  static void report(Callback<void(const char *)> print);
+
+private:
+  static ThreadLoad *find(const char *name);
+
+  const char *_name;
+  uint64_t _cycles;
+  uint32_t _start;
+  bool _busy;
+  ThreadLoad *_next;
+  static ThreadLoad *_first;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "Trace.h"
+
+#include "hal/us_ticker_api.h"
+
+#include <atomic>
+
+// Records kept, a power of two, 8 bytes each
+#define TRACE_RECORDS 256
+
+namespace {
+
+traceformat::Record records[TRACE_RECORDS];
+std::atomic<uint32_t> head(0);
+std::atomic<bool> paused(false);
+std::atomic<uint32_t> lost(0);
+
+} // namespace
+
+void Trace::log(TraceEvent event, uint8_t arg, uint16_t value) {
+  if (paused.load(std::memory_order_relaxed)) {
+    lost.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // an interrupt between taking the slot and reading the time can leave
+  // two records a few us out of order, the decoder shows that as is
+  uint32_t slot = head.fetch_add(1, std::memory_order_relaxed);
+  traceformat::Record &record = records[slot % TRACE_RECORDS];
+  record.time = us_ticker_read();
+  record.event = event;
+  record.arg = arg;
+  record.value = value;
+}
+
+void Trace::dump(Callback<void(const char *)> print) {
+  char line[32];
+  paused = true;
+  uint32_t total = head.load();
+  uint32_t count = total < TRACE_RECORDS ? total : TRACE_RECORDS;
+  snprintf(line, sizeof(line), "TRACE %u %lu %lu",
+           (unsigned)traceformat::VERSION, (unsigned long)count,
+           (unsigned long)(total - count + lost.load()));
+  print(line);
+  for (uint32_t i = total - count; i != total; i++) {
+    const traceformat::Record &record = records[i % TRACE_RECORDS];
+    snprintf(line, sizeof(line), "%08lx%02x%02x%04x",
+             (unsigned long)record.time, (unsigned)record.event,
+             (unsigned)record.arg, (unsigned)record.value);
+    print(line);
+  }
+  print("END");
+  paused = false;
+}
+
+uint32_t Trace::count() { return head.load(std::memory_order_relaxed); }
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "mbed.h"
+
+#include "TraceFormat.h"
+
+/** Ring buffer of the last trace events, for finding out what happened.
+ *
+ * log() takes a slot with one atomic increment and fills it in, so it
+ * needs no lock and is safe from interrupts of any priority and from
+ * threads. When the buffer is full the oldest records are overwritten.
+ * dump() sends the records as text, see TraceFormat.h, and
+ * sim/trace_decode turns that into a timeline.
+ *
+ * Example:
+ * @code
+ * Trace::log(TRACE_SEGMENT, segment.ramp, segment.speed);
+ * Trace::dump(callback(&printLine));
+ * @endcode
+ */
+class Trace {
+public:
+  /** Record an event
+   * @param event What happened
+   * @param arg Small argument, see TraceEvent
+   * @param value Payload, see TraceEvent
+   */
+  static void log(TraceEvent event, uint8_t arg = 0, uint16_t value = 0);
+
+  /** Send all records, oldest first, from a thread. Events are not
+   * recorded meanwhile, they count as lost.
+   * @param print Called for every line, without line end
+   */
+  static void dump(Callback<void(const char *)> print);
+
+  /** Number of events recorded so far, including overwritten ones */
+  static uint32_t count();
+};
+
+#endif
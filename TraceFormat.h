@@ -0,0 +1,53 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/* Trace records and the text dump they are sent in. Only needs the C
+ * library, the host decoder in sim/ uses it as well.
+ *
+ * A dump is a line "TRACE <version> <records> <lost>", one line of 16 hex
+ * digits per record, oldest first, and a line "END". A record line is the
+ * time, the event, the argument and the value as fixed width hex numbers.
+ */
+
+/** What a trace record is about */
+enum TraceEvent {
+  TRACE_NONE,      ///< unused slot
+  TRACE_INPUT,     ///< debounced inputs, arg 0 pressed, 1 released, 2 held
+  TRACE_CONTROL,   ///< control thread takes a message, arg its kind
+  TRACE_STATE,     ///< mode transition, arg from << 4 | to, value speed
+  TRACE_SEGMENT,   ///< ride segment applied, arg ramp, value speed
+  TRACE_SPEED,     ///< stepper target, arg 0 ramp 1 jump, value index
+  TRACE_RAMP_DONE, ///< stepper reached its target, value index
+  TRACE_EMERGENCY, ///< emergency stop interrupt, value latency in cycles
+  TRACE_LCD,       ///< display op done, arg clear/print/leds/animate/glyph,
+                   ///< value us the display thread spent on it
+  TRACE_EVENTS
+};
+
+namespace traceformat {
+
+const uint16_t VERSION = 1;
+
+/** One event, 8 bytes */
+struct Record {
+  uint32_t time;  ///< us ticker, stops in deep sleep
+  uint8_t event;  ///< TraceEvent
+  uint8_t arg;    ///< small argument
+  uint16_t value; ///< payload
+};
+
+static_assert(sizeof(Record) == 8, "Record is a dump format");
+
+/** Name of an event, e.g. "segment" */
+inline const char *name(uint8_t event) {
+  static const char *const names[TRACE_EVENTS] = {
+      "none",  "input",     "control",   "state", "segment",
+      "speed", "ramp done", "emergency", "lcd"};
+  return event < TRACE_EVENTS ? names[event] : "?";
+}
+
+} // namespace traceformat
+
+#endif
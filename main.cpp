@@ -1,278 +1,732 @@
 #include "mbed.h"
 
-// LCD header file
+// LCD, display queue and bar graph header files
+#include "BarGraph.h"
+#include "Display.h"
 #include "LCD.h"
 
-// Define motor speeds
-#define MOTOR_STOP 50
-#define MOTOR_SUPER_SLOW 45
-#define MOTOR_SLOW 40
-#define MOTOR_MEDIUM 20
-#define MOTOR_FAST 10
-#define MOTOR_SUPER_FAST 5
+// Messages to the control thread, state, thread load, profiling and trace
+// header files
+#include "CarouselState.h"
+#include "IrqLock.h"
+#include "Mailbox.h"
+#include "Profile.h"
+#include "ThreadLoad.h"
+#include "Trace.h"
+
+// GPIO, stepper, step timing, motion profile, phase table and emergency stop
+// header files
+#include "Delay.h"
+#include "EmergencyStop.h"
+#include "GpioOut.h"
+#include "MotionProfile.h"
+#include "PhaseTable.h"
+#include "StepTiming.h"
+#include "Stepper.h"
+
+// Input debouncing header files
+#include "Debouncer.h"
+
+// Ride program header files
+#include "EventScheduler.h"
+#include "RideProgram.h"
+#include "RideStore.h"
+#include "RideUpload.h"
+
+// Define the number of carousels on the board, 1 to 4, see mbed_app.json.
+// Every carousel has its own motor, ride and state, the mode switches, the
+// emergency stop, the LCD and the LEDs are shared.
+#define CAROUSELS MBED_CONF_APP_CAROUSELS
+static_assert(CAROUSELS >= 1 && CAROUSELS <= 4, "1 to 4 carousels");
+
+// Define motor coil bits, carousel 1 on PortC, carousels 2 to 4 on PortB
+#define MOTOR_COILS 0xf00     // PC8..PC11
+#define MOTOR_COILS_2 0xf000  // PB12..PB15
+#define MOTOR_COILS_3 0x00f0  // PB4..PB7
+#define MOTOR_COILS_4 0x0f00  // PB8..PB11
+
+// Define motor speeds in half steps/s
+#define MOTOR_STOP 40
+#define MOTOR_SUPER_SLOW 44
+#define MOTOR_SLOW 50
+#define MOTOR_MEDIUM 100
+#define MOTOR_FAST 200
+#define MOTOR_SUPER_FAST 400
+
+// Define (peak) acceleration between motor speeds in half steps/s^2
+#define MOTOR_ACCELERATION 200
 
 // Define time intervals
-#define TIME_SPEED_CHANGE 100ms
+#define TIME_SAMPLE_INPUTS 5ms
 #define TIME_SPEED_WALK_LIGHT 250ms
+#define TIME_BLINK_EMERGENCY 200ms
+#define TIME_GAUGES 250ms
 #define WALK_LIGHT_SIZE 6
 
-// Define patterns for walk light and motor rotation
-unsigned char const walkLight[] = {0b1, 0b10, 0b1000, 0b100000, 0b10000, 0b100};
-unsigned int const motorCW[] = {0x300, 0x600, 0xc00, 0x900};
-
-// Define interrupts for on/off switch, rotation, and emergency stop
-InterruptIn InterruptOnOff(PA_1);
-InterruptIn InterruptRotate(PA_6);
-InterruptIn InterruptEmergency(PA_10);
-
-// Create a LCD object
+// Define the gauges on row 2 of the LCD: the speed of the motor up to
+// MOTOR_SUPER_FAST on the left, the time left of the ride on the right
+#define GAUGE_SPEED_POS 0x40
+#define GAUGE_SPEED_CELLS 7
+#define GAUGE_TIME_POS 0x48
+#define GAUGE_TIME_CELLS 8
+
+// Define LEDs of the on/off state and the walk light
+#define LEDS_ON_OFF 0x03
+#define LEDS_WALK_LIGHT 0xfc
+
+// Define patterns for walk light, emergency blinking and motor rotation
+uint8_t const walkLight[] = {0b1 << 2,      0b10 << 2,    0b1000 << 2,
+                             0b100000 << 2, 0b10000 << 2, 0b100 << 2};
+uint8_t const blinkEmergency[] = {0b01, 0b10};
+typedef PhaseTable<MOTOR_COILS, DRIVE_HALF_STEP> MotorPhases;
+typedef PhaseTable<MOTOR_COILS_2, DRIVE_HALF_STEP> MotorPhases2;
+typedef PhaseTable<MOTOR_COILS_3, DRIVE_HALF_STEP> MotorPhases3;
+typedef PhaseTable<MOTOR_COILS_4, DRIVE_HALF_STEP> MotorPhases4;
+
+// Define the inputs, as bits of the sampled input word: the on/off and
+// rotate buttons of the carousels on PortA, the mode switches PB_0..PB_2
+// from bit 16. No button is on PA10..PA15, the emergency stop on PA10 needs
+// the EXTI15_10 interrupt alone. PA5 drives LD2 of the Nucleo board, remove
+// SB21 for the fourth rotate button.
+#define INPUT_ON_OFF (1 << 1)    // PA1
+#define INPUT_ROTATE (1 << 6)    // PA6
+#define INPUT_ON_OFF_2 (1 << 0)  // PA0
+#define INPUT_ROTATE_2 (1 << 4)  // PA4
+#define INPUT_ON_OFF_3 (1 << 7)  // PA7
+#define INPUT_ROTATE_3 (1 << 8)  // PA8
+#define INPUT_ON_OFF_4 (1 << 9)  // PA9
+#define INPUT_ROTATE_4 (1 << 5)  // PA5
+#define INPUT_MODES_SHIFT 16
+
+#if CAROUSELS == 1
+#define INPUT_BUTTONS (INPUT_ON_OFF | INPUT_ROTATE)
+#elif CAROUSELS == 2
+#define INPUT_BUTTONS                                                          \
+  (INPUT_ON_OFF | INPUT_ROTATE | INPUT_ON_OFF_2 | INPUT_ROTATE_2)
+#elif CAROUSELS == 3
+#define INPUT_BUTTONS                                                          \
+  (INPUT_ON_OFF | INPUT_ROTATE | INPUT_ON_OFF_2 | INPUT_ROTATE_2 |             \
+   INPUT_ON_OFF_3 | INPUT_ROTATE_3)
+#else
+#define INPUT_BUTTONS                                                          \
+  (INPUT_ON_OFF | INPUT_ROTATE | INPUT_ON_OFF_2 | INPUT_ROTATE_2 |             \
+   INPUT_ON_OFF_3 | INPUT_ROTATE_3 | INPUT_ON_OFF_4 | INPUT_ROTATE_4)
+#endif
+PortIn buttons(PortA, INPUT_BUTTONS);
+PortIn modeSelect(PortB, 0x7);
+
+// Define interrupts for the buttons, they only wake the debouncer
+InterruptIn buttonEdges[] = {{PA_1}, {PA_6},
+#if CAROUSELS > 1
+                             {PA_0}, {PA_4},
+#endif
+#if CAROUSELS > 2
+                             {PA_7}, {PA_8},
+#endif
+#if CAROUSELS > 3
+                             {PA_9}, {PA_5},
+#endif
+};
+
+// Define ports for motors and LEDs, written through BSRR so the step
+// interrupt and the display thread cannot clobber each other's bits
+GpioOut<PortC, MOTOR_COILS> motor;
+#if CAROUSELS > 1
+GpioOut<PortB, MOTOR_COILS_2> motor2;
+#endif
+#if CAROUSELS > 2
+GpioOut<PortB, MOTOR_COILS_3> motor3;
+#endif
+#if CAROUSELS > 3
+GpioOut<PortB, MOTOR_COILS_4> motor4;
+#endif
+GpioOut<PortC, 0xff> leds;
+
+// Create a LCD object, the LCD and the LEDs are written by the display
+// thread only
 lcd mylcd;
-Timer measuredTimeBetweenInterrupts;
-Ticker tickerSpeedControl;
-Ticker tickerWalkLight;
-
-Timeout timeouts[5];
-
-// Define ports for motor and LEDs
-PortOut motor(PortC, 0xf00);
-PortOut leds(PortC, 0xff);
-
-// Define digital inputs for mode selection
-DigitalIn modeSelect[] = {PB_0, PB_1, PB_2};
-
-// Define volatile variables for on/off state, rotation state, emergency state,
-// and off after stop state
-bool volatile _on = false;
-bool volatile _rotate = false;
-bool volatile _emergency = false;
-bool volatile _offAfterStop = false;
-
-// Define variables for mode, speed, new speed, and walk light index
-char _mode = 0;
-char _speed = MOTOR_SUPER_FAST;
-char _newSpeed;
-char _walkLightIndex = 0;
-
-// Function to clear the LCD
-void lcdClear() {
-  mylcd.clear();
-  mylcd.printf("                ");
+Display display(mylcd, leds.bits());
+BarGraph speedGauge(GAUGE_SPEED_POS, GAUGE_SPEED_CELLS);
+BarGraph timeGauge(GAUGE_TIME_POS, GAUGE_TIME_CELLS);
+
+// Define the messages of the interrupts to the control thread (main), which
+// owns the state of the carousel
+enum ControlKind {
+  CONTROL_ON_OFF,
+  CONTROL_ROTATE,
+  CONTROL_SEGMENT,
+  CONTROL_RAMP_DONE,
+  CONTROL_EMERGENCY,
+  CONTROL_GAUGES
+};
+
+struct ControlMessage {
+  uint8_t kind;
+  uint8_t carousel;
+  const RideSegment *segment; // CONTROL_SEGMENT
+};
+
+// Most messages that can wait: per carousel a press of each button, a due
+// segment and a ramp done, plus the emergency and one gauge tick
+#define CONTROL_WORST_CASE (CAROUSELS * 4 + 2)
+#define CONTROL_SLOTS 32
+static_assert(CONTROL_WORST_CASE <= CONTROL_SLOTS,
+              "the control mailbox must hold the worst case");
+
+Mailbox<ControlMessage, CONTROL_SLOTS> control;
+ThreadLoad controlLoad("main");
+
+// Define S-curve ramps between the motor speeds
+typedef MotionProfile<RAMP_S_CURVE, MOTOR_ACCELERATION, MOTOR_STOP,
+                      MOTOR_SUPER_SLOW, MOTOR_SLOW, MOTOR_MEDIUM, MOTOR_FAST,
+                      MOTOR_SUPER_FAST>
+    RideProfile;
+
+// Step all motors from one timer: the scheduler always arms the earliest
+// step of all of them
+EventScheduler steps;
+
+// Play the rides from one timer
+EventScheduler scheduler;
+
+// Define what every carousel has on its own: the step generator of its
+// motor, the ride it plays, its buttons and its mode
+struct Carousel {
+  Stepper stepper;
+  RideRunner ride;
+  uint32_t inputOnOff;
+  uint32_t inputRotate;
+  uint8_t number; // from 0, the first one shows on the LEDs and the LCD
+  CarouselState state;
+#if MBED_CONF_APP_STEP_TIMING
+  // Step intervals and input latencies, sent on 's'
+  StepTiming timing;
+#endif
+};
+
+void dueSegment(Carousel *carousel, const RideSegment &segment);
+Carousel carousels[] = {
+    {{steps, motor.bits(), MotorPhases::cwSetReset(), MotorPhases::length},
+     {scheduler, callback(&dueSegment, &carousels[0])},
+     INPUT_ON_OFF,
+     INPUT_ROTATE,
+     0},
+#if CAROUSELS > 1
+    {{steps, motor2.bits(), MotorPhases2::cwSetReset(), MotorPhases2::length},
+     {scheduler, callback(&dueSegment, &carousels[1])},
+     INPUT_ON_OFF_2,
+     INPUT_ROTATE_2,
+     1},
+#endif
+#if CAROUSELS > 2
+    {{steps, motor3.bits(), MotorPhases3::cwSetReset(), MotorPhases3::length},
+     {scheduler, callback(&dueSegment, &carousels[2])},
+     INPUT_ON_OFF_3,
+     INPUT_ROTATE_3,
+     2},
+#endif
+#if CAROUSELS > 3
+    {{steps, motor4.bits(), MotorPhases4::cwSetReset(), MotorPhases4::length},
+     {scheduler, callback(&dueSegment, &carousels[3])},
+     INPUT_ON_OFF_4,
+     INPUT_ROTATE_4,
+     3},
+#endif
+};
+
+// Emergency stop, cuts the coils of all motors in the highest priority
+// interrupt and then runs emergency() in its own thread
+Stepper *const motors[] = {&carousels[0].stepper,
+#if CAROUSELS > 1
+                           &carousels[1].stepper,
+#endif
+#if CAROUSELS > 2
+                           &carousels[2].stepper,
+#endif
+#if CAROUSELS > 3
+                           &carousels[3].stepper,
+#endif
+};
+void emergency();
+EmergencyStop emergencyStop(PA_10, motors, CAROUSELS, callback(&emergency));
+
+// Define the built-in rides as segments of (time from start, speed, ramp,
+// text), used while the data EEPROM holds no ride image
+constexpr RideSegment rideToddler[] = {
+    rideSegment(0ms, MOTOR_SUPER_SLOW, RIDE_JUMP, "     Toddler    "),
+    rideSegment(0ms, MOTOR_SLOW, RIDE_RAMP),
+    rideSegment(3min, MOTOR_STOP, RIDE_RAMP)};
+
+constexpr RideSegment rideKids[] = {
+    rideSegment(0ms, MOTOR_SUPER_SLOW, RIDE_JUMP, "      Kids      "),
+    rideSegment(0ms, MOTOR_SLOW, RIDE_RAMP),
+    rideSegment(30s, MOTOR_MEDIUM, RIDE_RAMP),
+    rideSegment(150s, MOTOR_SLOW, RIDE_RAMP),
+    rideSegment(180s, MOTOR_STOP, RIDE_RAMP)};
+
+constexpr RideSegment rideAction[] = {
+    rideSegment(0ms, MOTOR_SUPER_SLOW, RIDE_JUMP, "     Action     "),
+    rideSegment(0ms, MOTOR_SLOW, RIDE_RAMP),
+    rideSegment(10s, MOTOR_MEDIUM, RIDE_RAMP),
+    rideSegment(30s, MOTOR_FAST, RIDE_RAMP),
+    rideSegment(150s, MOTOR_MEDIUM, RIDE_RAMP),
+    rideSegment(170s, MOTOR_SLOW, RIDE_RAMP),
+    rideSegment(3min, MOTOR_STOP, RIDE_RAMP)};
+
+// Define the ride of every mode
+const RideProgram rides[] = {rideProgram(rideToddler), rideProgram(rideKids),
+                             rideProgram(rideAction)};
+
+// Debounce buttons and mode switches, an input counts once it read the same
+// for 4 samples
+uint32_t sampleInputs();
+void inputsChanged(InputEvents events);
+Debouncer debouncer(callback(&sampleInputs), callback(&inputsChanged),
+                    TIME_SAMPLE_INPUTS);
+
+// Rides loaded from the data EEPROM and uploaded over the serial port
+bool validSegment(const RideSegment &segment);
+bool rideIdle();
+RideStore store(MOTOR_STOP, callback(&validSegment));
+RideUpload upload(store, callback(&rideIdle));
+
+// Function to clear the LCD, if it shows the carousel
+void lcdClear(const Carousel &carousel) {
+  if (carousel.number == 0) {
+    display.clear();
+    speedGauge.reset();
+    timeGauge.reset();
+  }
 }
 
-// Function to turn on LEDs
-void onLEDs(char mask) { leds = leds | mask; }
-
-// Function to turn off LEDs
-void offLEDs(char mask) { leds = leds & ~mask; }
+// Function to set the on/off LED, if the carousel has it
+void setLedOnOff(const Carousel &carousel, bool on) {
+  if (carousel.number == 0)
+    display.leds(LEDS_ON_OFF, on ? 0b10 : 0b01);
+}
 
-// Function to get the state of LEDs
-char getLEDs(char mask = 0xff) { return leds & mask; }
+// Function to start or stop the walk light, if the carousel has it
+void setWalkLight(const Carousel &carousel, bool on) {
+  if (carousel.number == 0)
+    display.animate(LEDS_WALK_LIGHT, walkLight, on ? WALK_LIGHT_SIZE : 0,
+                    TIME_SPEED_WALK_LIGHT);
+}
 
-// Function to set the on/off LED
-void setLedOnOff(bool on) {
-  offLEDs(3);
-  if (on)
-    onLEDs(2);
-  else
-    onLEDs(1);
+// Function to post a message about a carousel to the control thread. The
+// mailbox holds the worst case, a lost message would leave a carousel in
+// its state for good.
+void post(ControlKind kind, const Carousel &carousel,
+          const RideSegment *segment = NULL) {
+  ControlMessage message = {(uint8_t)kind, carousel.number, segment};
+  bool posted = control.post(message);
+  MBED_ASSERT(posted);
+  (void)posted;
 }
 
-// Function to set the walk light
-void setWalkLight(char mask) {
-  onLEDs(mask << 2);
-  offLEDs(~mask << 2);
+// Function to tell the control thread that a stepper reached a speed
+void rampDone(Carousel *carousel) { post(CONTROL_RAMP_DONE, *carousel); }
+
+// Function to change the speed, the stepper ramps there step by step
+void changeSpeed(Carousel &carousel, uint32_t newSpeed) {
+  carousel.stepper.rampTo(RideProfile::index(newSpeed));
 }
 
-// Function to update the walk light
-void tickWalkLight() {
-  if (_rotate && _on) {
-    setWalkLight(walkLight[_walkLightIndex]);
-    if (_walkLightIndex == WALK_LIGHT_SIZE - 1)
-      _walkLightIndex = 0;
-    else
-      _walkLightIndex++;
+// Function to slow stop
+void slowStop(Carousel &carousel) { changeSpeed(carousel, MOTOR_STOP); }
+
+// Function to apply a ride segment, in the control thread. Segments that
+// were due before the ride was stopped are dropped.
+void applySegment(Carousel &carousel, const RideSegment &segment) {
+  Trace::log(TRACE_SEGMENT, segment.ramp, segment.speed);
+  CarouselState::Value now = carousel.state.get();
+  if (now.mode != CAROUSEL_RAMPING && now.mode != CAROUSEL_RUNNING)
+    return;
+  if (segment.ramp == RIDE_JUMP) {
+    if (!carousel.state.transition(now.mode, CAROUSEL_RUNNING, segment.speed))
+      return;
+    carousel.stepper.setSpeedIndex(RideProfile::index(segment.speed));
   } else {
-    setWalkLight(0);
+    if (!carousel.state.transition(now.mode, CAROUSEL_RAMPING, segment.speed))
+      return;
+    changeSpeed(carousel, segment.speed);
+  }
+  if (segment.text[0] && carousel.number == 0) {
+    lcdClear(carousel);
+    display.print(0, segment.text);
   }
 }
 
-// Function to check the time between interrupts
-bool checkTimeBetweenInterrupts() {
-  if (measuredTimeBetweenInterrupts.elapsed_time() > 20ms) {
-    measuredTimeBetweenInterrupts.reset();
-    return true;
-  } else
-    return false;
+// Timer of the gauges, they update while the ride of the first carousel runs
+EventScheduler::Event gaugeEvent;
+EventScheduler::time_point gaugeDue;
+bool volatile gaugesPending = false; // a tick waits in the mailbox
+
+// Function to tell the control thread to update the gauges, in interrupt
+// context. Ticks are not queued up, one update catches up with all.
+void gaugesDue() {
+  gaugeDue += TIME_GAUGES;
+  scheduler.postAt(gaugeEvent, callback(&gaugesDue), gaugeDue);
+  if (gaugesPending)
+    return;
+  gaugesPending = true;
+  post(CONTROL_GAUGES, carousels[0]);
 }
 
-// Function to update the speed
-void tickChangeSpeed() {
-  if (_speed == _newSpeed) {
+// Function to start or stop the gauges, if the LCD shows the carousel
+void runGauges(const Carousel &carousel, bool on) {
+  if (carousel.number != 0)
     return;
-  } else if (_speed <= _newSpeed) {
-    _speed++;
-  } else if (_speed >= _newSpeed) {
-    _speed--;
+  if (on) {
+    gaugeDue = TickerDataClock::now();
+    scheduler.postAt(gaugeEvent, callback(&gaugesDue), gaugeDue);
+  } else {
+    scheduler.cancel(gaugeEvent);
   }
 }
 
-// Function to change the speed
-void changeSpeed(char newSpeed) { _newSpeed = newSpeed; }
+// Function to move a bar graph to a level, only the cells that change are
+// sent to the display
+void showGauge(BarGraph &gauge, uint16_t level) {
+  uint8_t pos;
+  char text[BarGraph::MAX_CELLS + 1];
+  if (gauge.set(level, pos, text) && !display.print(pos, text))
+    gauge.invalidate();
+}
 
-// Function to slow stop
-void slowStop() { changeSpeed(MOTOR_STOP); }
+// Function to show the speed of the motor and the time left of the ride
+// of the first carousel
+void updateGauges() {
+  Carousel &carousel = carousels[0];
+  CarouselMode mode = carousel.state.get().mode;
+  if (mode != CAROUSEL_RAMPING && mode != CAROUSEL_RUNNING &&
+      mode != CAROUSEL_STOPPING)
+    return;
+  uint32_t interval = carousel.stepper.stepInterval().count();
+  uint32_t speed = interval ? 1000000 / interval : 0;
+  showGauge(speedGauge, (speed * speedGauge.levels() + MOTOR_SUPER_FAST / 2) /
+                            MOTOR_SUPER_FAST);
+  // rounded up, so the bar is empty when the ride ends
+  uint32_t length = carousel.ride.length().count();
+  uint32_t left = carousel.ride.remaining().count();
+  showGauge(timeGauge, length ? ((uint64_t)left * timeGauge.levels() +
+                                 length - 1) / length
+                              : 0);
+}
 
-// Function to change speed to slow
-void changeSpeedSlow() { changeSpeed(MOTOR_SLOW); }
+// Function to check that a stored segment only uses our speeds
+bool validSegment(const RideSegment &segment) {
+  return segment.speed == MOTOR_STOP ||
+         RideProfile::index(segment.speed) != 0;
+}
 
-// Function to change speed to medium
-void changeSpeedMedium() { changeSpeed(MOTOR_MEDIUM); }
+// Function to hand a ride segment that became due to the control thread,
+// the first segments are due at once when the control thread starts a ride
+void dueSegment(Carousel *carousel, const RideSegment &segment) {
+  if (core_util_is_isr_active())
+    post(CONTROL_SEGMENT, *carousel, &segment);
+  else
+    applySegment(*carousel, segment);
+}
 
-// Function to change speed to fast
-void changeSpeedFast() { changeSpeed(MOTOR_FAST); }
+// Function to tell the upload whether the rides are unused. The control
+// thread starts rides and preempts the upload thread, so this cannot change
+// between its check of upload.writing() and the start.
+bool rideIdle() {
+  for (Carousel &carousel : carousels) {
+    CarouselMode mode = carousel.state.get().mode;
+    if (mode != CAROUSEL_OFF && mode != CAROUSEL_IDLE)
+      return false;
+  }
+  return true;
+}
 
-// Function to set toddler mode
-void modeToddler() {
-  _speed = MOTOR_SUPER_SLOW;
-  changeSpeed(MOTOR_SLOW);
-  timeouts[0].attach(&slowStop, 3min);
-  mylcd.clear();
-  mylcd.printf("     Toddler    ");
+// Function to check whether all carousels are switched off
+bool allOff() {
+  for (Carousel &carousel : carousels) {
+    if (carousel.state.get().mode != CAROUSEL_OFF)
+      return false;
+  }
+  return true;
 }
 
-// Function to set kids mode
-void modeKids() {
-  _speed = MOTOR_SUPER_SLOW;
-  changeSpeed(MOTOR_SLOW);
-  timeouts[0].attach(&changeSpeedMedium, 30s);
-  timeouts[1].attach(&changeSpeedSlow, 150s);
-  timeouts[2].attach(&slowStop, 180s);
-  mylcd.clear();
-  mylcd.printf("      Kids      ");
+// Function to read all inputs at once for the debouncer
+uint32_t sampleInputs() {
+  return buttons.read() | modeSelect.read() << INPUT_MODES_SHIFT;
 }
 
-// Function to set action mode
-void modeAction() {
-  _speed = MOTOR_SUPER_SLOW;
-  changeSpeed(MOTOR_SLOW);
-  timeouts[0].attach(&changeSpeedMedium, 10s);
-  timeouts[1].attach(&changeSpeedFast, 30s);
-  timeouts[2].attach(&changeSpeedMedium, 150s);
-  timeouts[3].attach(&changeSpeedSlow, 170s);
-  timeouts[4].attach(&slowStop, 3min);
-  mylcd.clear();
-  mylcd.printf("     Action     ");
+// Function to post the debounced button presses, in the sample interrupt
+void inputsChanged(InputEvents events) {
+  if (events.pressed)
+    Trace::log(TRACE_INPUT, 0, events.pressed);
+  if (events.released)
+    Trace::log(TRACE_INPUT, 1, events.released);
+  if (events.held)
+    Trace::log(TRACE_INPUT, 2, events.held);
+  for (Carousel &carousel : carousels) {
+    if (events.pressed & carousel.inputOnOff)
+      post(CONTROL_ON_OFF, carousel);
+    if (events.pressed & carousel.inputRotate)
+      post(CONTROL_ROTATE, carousel);
+  }
 }
 
-// Interrupt service routine for on/off toggle
-void isr_onOff_toggle() {
-  InterruptOnOff.disable_irq();
-  if (checkTimeBetweenInterrupts()) {
-    if (_on) {
-      timeouts[0].detach();
-      timeouts[1].detach();
-      timeouts[2].detach();
-      timeouts[3].detach();
-      timeouts[4].detach();
-      if (!_rotate) {
-        _on = false;
-        setLedOnOff(_on);
-        lcdClear();
-      } else {
-        slowStop();
-        _offAfterStop = true;
-      }
-    } else {
-      _on = true;
-      setLedOnOff(_on);
+// Function to take the edge of the last button press as the start of a
+// latency, it ends now or, for rotate, with the first step
+void measureLatency(Carousel &carousel, TimingInput input) {
+#if MBED_CONF_APP_STEP_TIMING
+  carousel.timing.input(input, debouncer.wakeCycles());
+  if (input != TIMING_ROTATE)
+    carousel.timing.reaction(input, Delay::cycles());
+#endif
+}
+
+// Function to switch on or off, off waits for the ride to slow down
+void onOff(Carousel &carousel) {
+  CarouselState::Value now = carousel.state.get();
+  switch (now.mode) {
+  case CAROUSEL_OFF:
+    if (carousel.state.transition(CAROUSEL_OFF, CAROUSEL_IDLE)) {
+      measureLatency(carousel, TIMING_ON_OFF);
+      setLedOnOff(carousel, true);
+    }
+    break;
+  case CAROUSEL_IDLE:
+    if (carousel.state.transition(CAROUSEL_IDLE, CAROUSEL_OFF)) {
+      measureLatency(carousel, TIMING_ON_OFF);
+      setLedOnOff(carousel, false);
+      lcdClear(carousel);
+    }
+    break;
+  case CAROUSEL_RAMPING:
+  case CAROUSEL_RUNNING:
+    if (carousel.state.transition(now.mode, CAROUSEL_STOPPING, MOTOR_STOP)) {
+      measureLatency(carousel, TIMING_ON_OFF);
+      carousel.ride.cancel();
+      slowStop(carousel);
     }
+    break;
+  default:
+    break;
   }
-  InterruptOnOff.enable_irq();
 }
 
-// Interrupt service routine for rotation
-void isr_rotate() {
-  if (_on && _rotate == false) {
-    _rotate = true;
-    if (modeSelect[0])
-      modeToddler();
-    else if (modeSelect[1])
-      modeKids();
-    else if (modeSelect[2])
-      modeAction();
-    else
-      _rotate = false;
+// Function to start the ride of the selected mode, the mode switches are
+// shared by all carousels
+void rotate(Carousel &carousel) {
+  if (upload.writing())
+    return;
+  uint32_t modes = debouncer.state() >> INPUT_MODES_SHIFT;
+  for (unsigned i = 0; i < sizeof(rides) / sizeof(rides[0]); i++) {
+    if (modes & 1 << i) {
+      if (!carousel.state.transition(CAROUSEL_IDLE, CAROUSEL_RUNNING,
+                                     MOTOR_STOP))
+        return;
+      carousel.ride.start(i < store.rides() ? store.ride(i) : rides[i]);
+      measureLatency(carousel, TIMING_ROTATE);
+      carousel.stepper.start();
+      setWalkLight(carousel, true);
+      runGauges(carousel, true);
+      return;
+    }
   }
 }
 
-// Interrupt service routine for emergency stop
-void isr_emergency() { _emergency = true; }
-
 // Function to prepare interrupts
 void prepareInterupts() {
-  // On/Off toggle
-  InterruptOnOff.mode(PullDown);
-  InterruptOnOff.rise(&isr_onOff_toggle);
-
-  // Rotate
-  InterruptRotate.mode(PullDown);
-  InterruptRotate.rise(&isr_rotate);
+  // The on/off and rotate buttons wake the debouncer on both edges
+  buttons.mode(PullDown);
+  for (InterruptIn &edge : buttonEdges) {
+    edge.mode(PullDown);
+    debouncer.wakeOn(edge);
+  }
+  debouncer.start();
 
   // Emergency
-  InterruptEmergency.mode(PullDown);
-  InterruptEmergency.rise(&isr_emergency);
+  emergencyStop.arm();
 }
 
-// Function to handle emergency stop
+// Function to enter the emergency mode and tell the control thread, runs in
+// the emergency thread once the coils are off. Whatever the control thread
+// was doing, its next transition fails.
 void emergency() {
-  motor = 0;
-  tickerSpeedControl.detach();
-  tickerWalkLight.detach();
-  setWalkLight(0);
-  InterruptEmergency.disable_irq();
-  InterruptOnOff.disable_irq();
-  InterruptRotate.disable_irq();
-  mylcd.clear();
-  mylcd.printf("     NOTHALT    ");
-  while (true) {
-    setLedOnOff(getLEDs(1));
-    thread_sleep_for(200);
+  bool stopped = false;
+  for (Carousel &carousel : carousels) {
+#if MBED_CONF_APP_STEP_TIMING
+    carousel.timing.latency(TIMING_EMERGENCY, emergencyStop.latencyNs());
+#endif
+    stopped |= carousel.state.emergency();
+  }
+  if (stopped)
+    post(CONTROL_EMERGENCY, carousels[0]);
+}
+
+// Function to show the emergency stop, nothing else happens afterwards
+void showEmergency() {
+  for (Carousel &carousel : carousels)
+    carousel.ride.cancel();
+  runGauges(carousels[0], false);
+  setWalkLight(carousels[0], false);
+  display.clear();
+  display.print(0, "     NOTHALT    ");
+  // Show the measured time from the interrupt to the coils off
+  char latency[17];
+  uint32_t ns = emergencyStop.latencyNs();
+  if (ns > 999999)
+    ns = 999999;
+  snprintf(latency, sizeof(latency), "  off in %u.%uus", (unsigned)(ns / 1000),
+           (unsigned)(ns % 1000 / 100));
+  display.print(0x40, latency);
+  display.animate(LEDS_ON_OFF, blinkEmergency, sizeof(blinkEmergency),
+                  TIME_BLINK_EMERGENCY);
+  // Send what led up to the stop, in case nobody asks for it, and how fast
+  // the stop reached the coils and this thread
+  Trace::dump(callback(&upload, &RideUpload::print));
+  char line[64];
+  snprintf(line, sizeof(line), "emergency off %lu ns, handoff %lu ns",
+           (unsigned long)emergencyStop.latencyNs(),
+           (unsigned long)emergencyStop.handoffNs());
+  upload.print(line);
+}
+
+// Function to handle the stepper reaching a speed, the ride ends once it
+// ramped down to the stop speed
+void reachedSpeed(Carousel &carousel) {
+  CarouselState::Value now = carousel.state.get();
+  if (!carousel.stepper.running() || carousel.stepper.ramping())
+    return;
+  if (now.speed != MOTOR_STOP) {
+    if (now.mode == CAROUSEL_RAMPING)
+      carousel.state.transition(CAROUSEL_RAMPING, CAROUSEL_RUNNING);
+    return;
+  }
+  CarouselMode next =
+      now.mode == CAROUSEL_STOPPING ? CAROUSEL_OFF : CAROUSEL_IDLE;
+  if (!carousel.state.transition(now.mode, next))
+    return;
+  carousel.stepper.stop();
+  setWalkLight(carousel, false);
+  runGauges(carousel, false);
+  if (next == CAROUSEL_OFF)
+    setLedOnOff(carousel, false);
+  lcdClear(carousel);
+}
+
+// Function to report how full a mailbox got and what it dropped
+void reportQueue(Callback<void(const char *)> print, const char *name,
+                 uint16_t maxDepth, uint32_t dropped) {
+  char line[48];
+  snprintf(line, sizeof(line), "queue %-8s max %u, dropped %lu", name,
+           maxDepth, (unsigned long)dropped);
+  print(line);
+}
+
+// Function to report the threads, the mailboxes, the longest time with
+// interrupts masked and the states of the carousels on the serial port
+void reportStatus(Callback<void(const char *)> print) {
+  ThreadLoad::report(print);
+  reportQueue(print, "display", display.maxDepth(), display.dropped());
+  reportQueue(print, "control", control.maxDepth(), control.dropped());
+  char line[40];
+  snprintf(line, sizeof(line), "irq masked max %lu ns",
+           (unsigned long)IrqLock::longestNs());
+  print(line);
+  for (Carousel &carousel : carousels) {
+    char line[16];
+    snprintf(line, sizeof(line), "carousel %u", carousel.number + 1);
+    print(line);
+    carousel.state.report(print);
   }
 }
 
-// main() runs in its own thread in the OS
+// Function to send the trace on the serial port
+void dumpTrace(Callback<void(const char *)> print) { Trace::dump(print); }
+
+#if MBED_CONF_APP_STEP_TIMING
+// Function to send the step timing on the serial port
+void reportStepTiming(Callback<void(const char *)> print) {
+  for (Carousel &carousel : carousels)
+    carousel.timing.report(print, carousel.number + 1);
+}
+
+// Function to measure the steps at every speed of the motors
+void prepareStepTiming() {
+  const uint32_t speeds[] = {MOTOR_STOP,   MOTOR_SUPER_SLOW, MOTOR_SLOW,
+                             MOTOR_MEDIUM, MOTOR_FAST,       MOTOR_SUPER_FAST};
+  for (Carousel &carousel : carousels) {
+    for (unsigned i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+      carousel.timing.addLevel(speeds[i], RideProfile::index(speeds[i]));
+    carousel.stepper.measure(&carousel.timing);
+  }
+  upload.onCommand('s', callback(&reportStepTiming));
+}
+#endif
+
+// Function to send the cycles of the profiled code on the serial port
+void reportProfile(Callback<void(const char *)> print) {
+  ProfileSite::report(print);
+}
+
+// Function to handle a message in the control thread
+void handle(const ControlMessage &message) {
+  // the gauge ticks would push everything else out of the trace
+  if (message.kind != CONTROL_GAUGES)
+    Trace::log(TRACE_CONTROL, message.kind, message.carousel);
+  Carousel &carousel = carousels[message.carousel];
+  switch (message.kind) {
+  case CONTROL_ON_OFF:
+    onOff(carousel);
+    break;
+  case CONTROL_ROTATE:
+    rotate(carousel);
+    break;
+  case CONTROL_SEGMENT:
+    applySegment(carousel, *message.segment);
+    break;
+  case CONTROL_RAMP_DONE:
+    reachedSpeed(carousel);
+    break;
+  case CONTROL_EMERGENCY:
+    showEmergency();
+    break;
+  case CONTROL_GAUGES:
+    gaugesPending = false;
+    updateGauges();
+    break;
+  }
+}
+
+// main() is the control thread: it makes the transitions of the carousels
+// and sleeps until an interrupt posts a message, so the controller can sleep
+// while nothing happens. The steppers generate the steps in the interrupt of
+// their shared timer, the display thread drives the LCD and the LEDs.
 int main() {
-  setLedOnOff(_on);
-  measuredTimeBetweenInterrupts.start();
-  tickerSpeedControl.attach(&tickChangeSpeed, TIME_SPEED_CHANGE);
-  tickerWalkLight.attach(&tickWalkLight, TIME_SPEED_WALK_LIGHT);
+  controlLoad.busy();
+  setLedOnOff(carousels[0], false);
+  for (Carousel &carousel : carousels) {
+    carousel.stepper.setProfile(RideProfile::intervals());
+    carousel.stepper.onRampDone(callback(&rampDone, &carousel));
+  }
+  store.load();
   prepareInterupts();
-  lcdClear();
+  display.start();
+  for (uint8_t columns = 1; columns <= BarGraph::GLYPHS; columns++)
+    display.glyph(BarGraph::code(columns), BarGraph::glyph(columns));
+  upload.onCommand('?', callback(&reportStatus));
+  upload.onCommand('t', callback(&dumpTrace));
+  upload.onCommand('p', callback(&reportProfile));
+#if MBED_CONF_APP_STEP_TIMING
+  prepareStepTiming();
+#endif
+  upload.start();
+  display.clear();
   while (true) {
-    if (_emergency) {
-      emergency();
-    }
-    for (char i = 0; i < 4; i++) {
-      if (_emergency) {
-        break;
-      }
-      if (_speed == MOTOR_STOP) {
-        _speed = MOTOR_STOP + 1;
-        _newSpeed = MOTOR_STOP + 1;
-        _rotate = false;
-        if (_offAfterStop) {
-          _offAfterStop = false;
-          _on = false;
-          setLedOnOff(false);
-        }
-        lcdClear();
-      }
-      if (_rotate) {
-        motor = motorCW[i];
-        thread_sleep_for(_speed);
-      } else {
-        motor = 0;
-      }
-    }
+    ControlMessage message;
+    controlLoad.idle();
+    control.receive(message);
+    controlLoad.busy();
+    handle(message);
+    // Uploads only while switched off, the receiver keeps the controller
+    // out of deep sleep
+    upload.listen(allOff());
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,423 @@
+#include "Sim.h"
+
+#include <stdio.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace sim {
+
+namespace {
+
+struct Record {
+  uint64_t time;
+  std::string signal;
+  std::string value;
+};
+
+// Function local statics, the controller's global objects already use the
+// simulation from their constructors
+struct State {
+  uint64_t now = 0; // in ns
+  uint64_t end = UINT64_MAX; // in ns
+  int interruptDepth = 0;
+  std::multimap<uint64_t, Event *> events;
+  std::map<int, int> pins;
+  std::map<int, PinListener *> listeners;
+  std::vector<Record> records;
+  std::string recordFile = "-";
+  std::vector<Task *> tasks;
+  Task *current = nullptr; // nullptr for the main task
+  uint64_t interruptNs = 0;
+  uint64_t idleNs = 0;
+  uint64_t interrupts = 0;
+  std::vector<void (*)()> atFinish;
+  int deepSleepLocks = 0;
+  uint64_t deepSleepWakeup = 0;
+  PowerStats power = PowerStats();
+};
+
+State &state() {
+  static State s;
+  return s;
+}
+
+// Host stacks, host library calls need far more than the target threads
+const size_t TASK_STACK = 256 * 1024;
+
+// Fill pattern of unused stack, like the RTX stack watermark
+const char STACK_FILL = (char)0xcc;
+
+// osPriorityNormal, like the main thread of mbed-os
+const int MAIN_PRIORITY = 24;
+
+} // namespace
+
+struct Task::Context {
+  enum Run { NEW, READY, BLOCKED, DONE };
+
+  class Timeout : public Event {
+  public:
+    explicit Timeout(Task *task) : _task(task) {}
+
+  private:
+    void fire() override;
+    Task *_task;
+  };
+
+  explicit Context(Task *task)
+      : run(NEW), woken(false), cpuNs(0), timeout(task) {}
+
+  ucontext_t context;
+  std::vector<char> stack;
+  Run run;
+  bool woken;
+  uint64_t cpuNs;
+  Timeout timeout;
+};
+
+// Access of the scheduler to Task and Event
+struct Scheduler {
+  static Task::Context &context(Task *task) { return *task->_context; }
+  static void run(Task *task) { task->run(); }
+  static void fire(Event *event) { event->fire(); }
+};
+
+namespace {
+
+Task &mainTask() {
+  static Task task(MAIN_PRIORITY, "main");
+  static bool running = false;
+  if (!running) {
+    running = true;
+    Scheduler::context(&task).run = Task::Context::READY;
+  }
+  return task;
+}
+
+Task *running() {
+  Task *current = state().current;
+  return current ? current : &mainTask();
+}
+
+// Highest priority ready task, the first one of equal priorities
+Task *highestReady() {
+  mainTask();
+  Task *best = nullptr;
+  for (Task *task : state().tasks) {
+    if (Scheduler::context(task).run == Task::Context::READY &&
+        (best == nullptr || task->priority() > best->priority()))
+      best = task;
+  }
+  return best;
+}
+
+void switchTo(Task *next) {
+  Task *previous = running();
+  if (next == previous)
+    return;
+  state().current = next;
+  swapcontext(&Scheduler::context(previous).context,
+              &Scheduler::context(next).context);
+}
+
+// Let a task of higher priority than the running one run, like the
+// context switch on return from an interrupt
+void preempt() {
+  Task *next = highestReady();
+  if (next && next->priority() > running()->priority())
+    switchTo(next);
+}
+
+// Move the clock on and charge the time to whoever spent it
+void moveClock(uint64_t time, bool idle) {
+  State &s = state();
+  if (time <= s.now)
+    return;
+  if (s.interruptDepth > 0) {
+    s.interruptNs += time - s.now;
+  } else if (idle) {
+    s.idleNs += time - s.now;
+    if (canDeepSleep())
+      s.power.deepSleepNs += time - s.now;
+  } else {
+    Scheduler::context(running()).cpuNs += time - s.now;
+  }
+  s.now = time;
+}
+
+// Run the earliest event in emulated interrupt context, after leaving deep
+// sleep if the controller was idle in it
+void fireNext(bool idle) {
+  State &s = state();
+  Event *event = s.events.begin()->second;
+  moveClock(event->time() * 1000, idle);
+  if (idle && s.now <= s.end)
+    s.power.wakeups++;
+  if (idle && canDeepSleep() && s.now <= s.end) {
+    s.power.deepWakeups++;
+    s.power.wakeupNs += s.deepSleepWakeup;
+    s.now += s.deepSleepWakeup;
+  }
+  if (s.now > s.end)
+    finish();
+  event->cancel();
+  s.interrupts++;
+  s.interruptDepth++;
+  Scheduler::fire(event);
+  s.interruptDepth--;
+}
+
+// The running task blocked or ended: run the next ready task, idling
+// through the events until one becomes ready
+void reschedule() {
+  State &s = state();
+  Task *next;
+  uint64_t due = 0;
+  while ((next = highestReady()) == nullptr) {
+    if (s.events.empty()) {
+      // nothing can happen any more
+      moveClock(s.end, true);
+      finish();
+    }
+    due = s.events.begin()->first * 1000;
+    fireNext(true);
+  }
+  if (due) {
+    uint64_t latency = s.now - due;
+    s.power.taskWakeups++;
+    s.power.latencySumNs += latency;
+    if (latency > s.power.latencyMaxNs)
+      s.power.latencyMaxNs = latency;
+  }
+  switchTo(next);
+}
+
+void taskEntry() {
+  Task *task = running();
+  Scheduler::run(task);
+  Scheduler::context(task).run = Task::Context::DONE;
+  reschedule();
+}
+
+} // namespace
+
+void Task::Context::Timeout::fire() {
+  Context &context = Scheduler::context(_task);
+  if (context.run == BLOCKED)
+    context.run = READY;
+}
+
+Task::Task(int priority, const char *name)
+    : _context(new Context(this)), _priority(priority), _name(name),
+      _flags(0) {
+  state().tasks.push_back(this);
+}
+
+Task::~Task() {
+  std::vector<Task *> &tasks = state().tasks;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    if (tasks[i] == this)
+      tasks.erase(tasks.begin() + i);
+  }
+  delete _context;
+}
+
+void Task::start() {
+  if (_context->run != Context::NEW)
+    return;
+  _context->stack.resize(TASK_STACK, STACK_FILL);
+  getcontext(&_context->context);
+  _context->context.uc_stack.ss_sp = _context->stack.data();
+  _context->context.uc_stack.ss_size = _context->stack.size();
+  _context->context.uc_link = nullptr;
+  makecontext(&_context->context, taskEntry, 0);
+  _context->run = Context::READY;
+  if (!inInterrupt())
+    preempt();
+}
+
+void Task::wake() {
+  if (_context->run != Context::BLOCKED)
+    return;
+  _context->run = Context::READY;
+  _context->woken = true;
+  _context->timeout.cancel();
+  if (!inInterrupt())
+    preempt();
+}
+
+uint32_t Task::setFlags(uint32_t flags) {
+  _flags |= flags;
+  uint32_t result = _flags;
+  wake();
+  return result;
+}
+
+uint32_t Task::clearFlags(uint32_t flags) {
+  uint32_t result = _flags;
+  _flags &= ~flags;
+  return result;
+}
+
+uint64_t Task::cpuNs() const { return _context->cpuNs; }
+
+uint32_t Task::stackSize() const { return _context->stack.size(); }
+
+// The stack grows down, the lowest byte that changed is the high-water mark
+uint32_t Task::stackUsed() const {
+  const std::vector<char> &stack = _context->stack;
+  size_t unused = 0;
+  while (unused < stack.size() && stack[unused] == STACK_FILL)
+    unused++;
+  return stack.size() - unused;
+}
+
+std::vector<Task *> tasks() {
+  mainTask();
+  return state().tasks;
+}
+
+Task *currentTask() { return running(); }
+
+uint64_t interruptNs() { return state().interruptNs; }
+
+uint64_t idleNs() { return state().idleNs; }
+
+uint64_t interrupts() { return state().interrupts; }
+
+bool block(uint64_t timeoutNs) {
+  Task *task = running();
+  Task::Context &context = Scheduler::context(task);
+  context.run = Task::Context::BLOCKED;
+  context.woken = false;
+  if (timeoutNs != UINT64_MAX)
+    context.timeout.schedule((nowNs() + timeoutNs + 999) / 1000);
+  reschedule();
+  context.timeout.cancel();
+  return context.woken;
+}
+
+Event::Event() : _time(0), _scheduled(false) {}
+
+Event::~Event() { cancel(); }
+
+void Event::schedule(uint64_t time) {
+  cancel();
+  _time = time;
+  _entry = state().events.insert(std::make_pair(time, this));
+  _scheduled = true;
+}
+
+void Event::cancel() {
+  if (_scheduled) {
+    state().events.erase(_entry);
+    _scheduled = false;
+  }
+}
+
+uint64_t now() { return state().now / 1000; }
+
+uint64_t nowNs() { return state().now; }
+
+bool inInterrupt() { return state().interruptDepth > 0; }
+
+void advance(uint64_t us) { advanceNs(us * 1000); }
+
+void advanceNs(uint64_t ns) {
+  State &s = state();
+  uint64_t target = s.now + ns;
+  if (s.interruptDepth == 0) {
+    while (!s.events.empty() && s.events.begin()->first * 1000 <= target &&
+           s.events.begin()->first * 1000 <= s.end) {
+      fireNext(false);
+      preempt();
+    }
+  }
+  moveClock(target, false);
+  if (s.now >= s.end)
+    finish();
+}
+
+void setEnd(uint64_t time) { state().end = time * 1000; }
+
+void lockDeepSleep() { state().deepSleepLocks++; }
+
+void unlockDeepSleep() { state().deepSleepLocks--; }
+
+bool canDeepSleep() { return state().deepSleepLocks == 0; }
+
+void setDeepSleepWakeup(uint64_t ns) { state().deepSleepWakeup = ns; }
+
+PowerStats powerStats() {
+  State &s = state();
+  PowerStats power = s.power;
+  power.interruptNs = s.interruptNs;
+  power.sleepNs = s.idleNs - s.power.deepSleepNs;
+  power.runNs = s.now - s.idleNs - s.interruptNs - s.power.wakeupNs;
+  return power;
+}
+
+void finish() {
+  State &s = state();
+  if (s.now > s.end)
+    s.now = s.end;
+  FILE *out = stdout;
+  if (s.recordFile != "-")
+    out = fopen(s.recordFile.c_str(), "w");
+  if (out == NULL) {
+    perror(s.recordFile.c_str());
+    _exit(1);
+  }
+  fprintf(out, "time_us,signal,value\n");
+  for (const Record &r : s.records) {
+    if (r.time * 1000 <= s.end)
+      fprintf(out, "%llu,%s,%s\n", (unsigned long long)r.time,
+              r.signal.c_str(), r.value.c_str());
+  }
+  fflush(out);
+  fprintf(stderr, "simulated %.3f s, %zu records\n", s.now / 1e9,
+          s.records.size());
+  for (void (*func)() : s.atFinish)
+    func();
+  _exit(0);
+}
+
+void atFinish(void (*func)()) { state().atFinish.push_back(func); }
+
+void record(const std::string &signal, const std::string &value) {
+  state().records.push_back(Record{now(), signal, value});
+}
+
+void setRecordFile(const std::string &path) { state().recordFile = path; }
+
+int pinLevel(int pin, int pull) {
+  std::map<int, int>::const_iterator it = state().pins.find(pin);
+  if (it == state().pins.end() || it->second < 0)
+    return pull;
+  return it->second;
+}
+
+void setPinLevel(int pin, int level) {
+  State &s = state();
+  s.pins[pin] = level;
+  std::map<int, PinListener *>::iterator it = s.listeners.find(pin);
+  if (it != s.listeners.end()) {
+    s.interruptDepth++;
+    it->second->pinChanged(pin);
+    s.interruptDepth--;
+  }
+}
+
+void listenPin(int pin, PinListener *listener) {
+  state().listeners[pin] = listener;
+}
+
+void unlistenPin(int pin, PinListener *listener) {
+  std::map<int, PinListener *>::iterator it = state().listeners.find(pin);
+  if (it != state().listeners.end() && it->second == listener)
+    state().listeners.erase(it);
+}
+
+} // namespace sim
@@ -0,0 +1,239 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Core of the host simulation: virtual clock, interrupt emulation, pins and
+ * output recording.
+ *
+ * Virtual time only passes when the controller waits (thread_sleep_for,
+ * ThisThread::sleep_for, wait_us). Timer and pin events that fall into the
+ * wait run in order as if they were interrupts. Waits inside an interrupt
+ * only move the clock on, so the events they delay run late, just like
+ * pending interrupts on the target.
+ *
+ * Threads are emulated as tasks with their own stack. A task runs until it
+ * blocks or an interrupt makes a task of higher priority ready, like on a
+ * preemptive RTOS without round robin between equal priorities.
+ */
+namespace sim {
+
+/** Something that happens at a point in virtual time */
+class Event {
+public:
+  Event();
+  virtual ~Event();
+
+  /** Schedule the event, replacing an earlier schedule
+   * @param time Virtual time in us
+   */
+  void schedule(uint64_t time);
+
+  /** Remove the event from the schedule */
+  void cancel();
+
+  /** Whether the event is scheduled */
+  bool scheduled() const { return _scheduled; }
+
+  /** Virtual time the event is or was last scheduled for */
+  uint64_t time() const { return _time; }
+
+protected:
+  /** Called in emulated interrupt context when the event is due */
+  virtual void fire() = 0;
+
+private:
+  friend struct Scheduler;
+  std::multimap<uint64_t, Event *>::iterator _entry;
+  uint64_t _time;
+  bool _scheduled;
+};
+
+/** Current virtual time in us */
+uint64_t now();
+
+/** Current virtual time in ns */
+uint64_t nowNs();
+
+/** Let virtual time pass, running all events that become due
+ * @param us Time to pass in us
+ */
+void advance(uint64_t us);
+
+/** Let virtual time pass, running all events that become due
+ * @param ns Time to pass in ns
+ */
+void advanceNs(uint64_t ns);
+
+/** Whether the caller runs in emulated interrupt context */
+bool inInterrupt();
+
+/** Stop the simulation at a virtual time
+ * @param time Virtual time in us
+ */
+void setEnd(uint64_t time);
+
+/** Write the recording and exit the process */
+void finish();
+
+/** Call a function in finish() before the process exits, e.g. to print
+ * statistics */
+void atFinish(void (*func)());
+
+/** Record an output change
+ * @param signal Name of the output
+ * @param value New value, as text
+ */
+void record(const std::string &signal, const std::string &value);
+
+/** Where finish() writes the recording, "-" for stdout */
+void setRecordFile(const std::string &path);
+
+/** Level of a pin as seen by the controller
+ * @param pin mbed PinName
+ * @param pull Level of the pin while it is not driven
+ */
+int pinLevel(int pin, int pull);
+
+/** Drive an input pin from outside the controller, triggers edge interrupts
+ * @param pin mbed PinName
+ * @param level New level, -1 to release the pin
+ */
+void setPinLevel(int pin, int level);
+
+/** Emulated RTOS thread */
+class Task {
+public:
+  /** Create a task, it runs once started
+   * @param priority Higher values preempt lower ones
+   * @param name Name for statistics
+   */
+  explicit Task(int priority, const char *name = nullptr);
+  virtual ~Task();
+
+  /** Make the task ready to run */
+  void start();
+
+  /** Make the task ready if it is blocked, from any context */
+  void wake();
+
+  /** Set thread flags and wake the task so it can check them
+   * @return The flags after setting
+   */
+  uint32_t setFlags(uint32_t flags);
+
+  /** Clear thread flags
+   * @return The flags before clearing
+   */
+  uint32_t clearFlags(uint32_t flags);
+
+  /** Current thread flags */
+  uint32_t flags() const { return _flags; }
+
+  int priority() const { return _priority; }
+
+  const char *name() const { return _name; }
+
+  /** Size of the host stack in bytes, 0 for the main task, which runs on
+   * the stack of the process */
+  uint32_t stackSize() const;
+
+  /** Most bytes of the host stack used so far, found by the fill pattern.
+   * Host code needs far more stack than the target, so this only shows
+   * which task needs most. */
+  uint32_t stackUsed() const;
+
+  /** Virtual time the task spent running, i.e. busy waiting */
+  uint64_t cpuNs() const;
+
+  /** Scheduler state, defined in Sim.cpp */
+  struct Context;
+
+protected:
+  /** Body of the task, runs on its own stack */
+  virtual void run() {}
+
+private:
+  friend struct Scheduler;
+  Context *_context;
+  int _priority;
+  const char *_name;
+  uint32_t _flags;
+};
+
+/** Task of the caller, code outside of any started task runs in the main
+ * task with normal priority */
+Task *currentTask();
+
+/** All tasks, including the main task */
+std::vector<Task *> tasks();
+
+/** Virtual time spent in interrupts, i.e. waits inside them */
+uint64_t interruptNs();
+
+/** Virtual time no task was ready */
+uint64_t idleNs();
+
+/** Number of interrupts run, timer and pin events */
+uint64_t interrupts();
+
+/** Keep the controller out of deep sleep, like sleep_manager of mbed-os.
+ * Locks are counted, every lock needs an unlock. */
+void lockDeepSleep();
+
+/** Release a lock of lockDeepSleep() */
+void unlockDeepSleep();
+
+/** Whether no deep sleep lock is held */
+bool canDeepSleep();
+
+/** Set the time the controller needs to leave deep sleep, the interrupt
+ * that wakes it runs this much later
+ * @param ns Wake-up time in ns
+ */
+void setDeepSleepWakeup(uint64_t ns);
+
+/** Where the virtual time went since start-up */
+struct PowerStats {
+  uint64_t runNs;        ///< Tasks running, i.e. busy waiting
+  uint64_t interruptNs;  ///< In interrupts
+  uint64_t sleepNs;      ///< Idle with a deep sleep lock held
+  uint64_t deepSleepNs;  ///< Idle in deep sleep
+  uint64_t wakeupNs;     ///< Leaving deep sleep
+  uint64_t wakeups;      ///< Interrupts that ended idling
+  uint64_t deepWakeups;  ///< Of them, from deep sleep
+  uint64_t taskWakeups;  ///< Times a task became ready while idle
+  uint64_t latencyMaxNs; ///< Longest time from waking event to task
+  uint64_t latencySumNs; ///< Sum of the times from waking event to task
+};
+
+/** Where the virtual time went since start-up */
+PowerStats powerStats();
+
+/** Block the current task until Task::wake() or a timeout
+ * @param timeoutNs Timeout in ns, UINT64_MAX for none
+ * @return Whether the task was woken before the timeout
+ */
+bool block(uint64_t timeoutNs);
+
+/** Receives changes of the external level of a pin, in emulated interrupt
+ * context */
+class PinListener {
+public:
+  virtual ~PinListener() {}
+  virtual void pinChanged(int pin) = 0;
+};
+
+/** Register for level changes of a pin, one listener per pin */
+void listenPin(int pin, PinListener *listener);
+
+/** Stop receiving level changes of a pin */
+void unlistenPin(int pin, PinListener *listener);
+
+} // namespace sim
+
+#endif
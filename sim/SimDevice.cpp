@@ -0,0 +1,121 @@
+#include "SimDevice.h"
+
+#include "Sim.h"
+#include "mbed.h"
+
+#include <deque>
+#include <list>
+
+uint32_t sim_data_eeprom[SIM_DATA_EEPROM_SIZE / 4];
+
+namespace {
+
+// Virtual time to erase and program one EEPROM word on the STM32L1
+const uint64_t EEPROM_WORD_NS = 3280000;
+
+bool eepromLocked = true;
+
+uint64_t byteNs = 10 * 1000000000ull / 9600;
+bool receiving = true;
+std::deque<uint8_t> received;
+sim::Task *reader = nullptr;
+std::string line;
+
+// Bytes on their way to the controller, one event per byte time
+class Transmission : public sim::Event {
+public:
+  Transmission(const std::string &bytes, uint64_t time)
+      : _bytes(bytes), _next(0) {
+    schedule(time);
+  }
+
+private:
+  void fire() override {
+    if (receiving)
+      received.push_back(_bytes[_next]);
+    _next++;
+    if (reader)
+      reader->wake();
+    if (_next < _bytes.size())
+      schedule(time() + (byteNs + 999) / 1000);
+  }
+  std::string _bytes;
+  size_t _next;
+};
+
+std::list<Transmission> transmissions;
+
+} // namespace
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock() {
+  eepromLocked = false;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock() {
+  eepromLocked = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t type,
+                                                 uintptr_t address,
+                                                 uint32_t data) {
+  if (eepromLocked || type != FLASH_TYPEPROGRAMDATA_WORD ||
+      address < DATA_EEPROM_BASE || address > DATA_EEPROM_END - 3 ||
+      address % 4 != 0)
+    return HAL_ERROR;
+  // The HAL waits for the end of the write
+  sim::advanceNs(EEPROM_WORD_NS);
+  sim_data_eeprom[(address - DATA_EEPROM_BASE) / 4] = data;
+  return HAL_OK;
+}
+
+namespace sim {
+
+void serialSend(const std::string &bytes, uint64_t time) {
+  if (!bytes.empty())
+    transmissions.emplace_back(bytes, time);
+}
+
+void serialOpen(int baud) { byteNs = 10 * 1000000000ull / baud; }
+
+void serialEnable(bool enabled) { receiving = enabled; }
+
+size_t serialRead(void *buffer, size_t length) {
+  while (received.empty()) {
+    reader = currentTask();
+    block(UINT64_MAX);
+  }
+  reader = nullptr;
+  size_t count = 0;
+  uint8_t *bytes = (uint8_t *)buffer;
+  while (count < length && !received.empty()) {
+    bytes[count++] = received.front();
+    received.pop_front();
+  }
+  return count;
+}
+
+void serialWrite(const void *buffer, size_t length) {
+  const char *text = (const char *)buffer;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] == '\n') {
+      record("serial", "\"" + line + "\"");
+      line.clear();
+    } else if (text[i] != '\r') {
+      line += text[i] == '"' ? '\'' : text[i];
+    }
+  }
+}
+
+bool loadEeprom(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+    return false;
+  memset(sim_data_eeprom, 0, sizeof(sim_data_eeprom));
+  fread(sim_data_eeprom, 1, sizeof(sim_data_eeprom), file);
+  fclose(file);
+  return true;
+}
+
+} // namespace sim
@@ -0,0 +1,48 @@
+#ifndef SIM_DEVICE_H
+#define SIM_DEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+/** Simulated peripherals besides the pins: the serial port to the host
+ * through the ST-LINK and the data EEPROM.
+ *
+ * Bytes sent to the controller arrive one at a time at the baud rate of the
+ * port. Every line the controller sends is recorded as signal "serial".
+ */
+namespace sim {
+
+/** Send bytes to the serial port of the controller
+ * @param bytes Bytes to send
+ * @param time Virtual time in us the first byte starts
+ */
+void serialSend(const std::string &bytes, uint64_t time);
+
+/** Open the serial port of the controller
+ * @param baud Baud rate, sets the time per received byte
+ */
+void serialOpen(int baud);
+
+/** Switch the receiver of the serial port, bytes are lost while it is off
+ * @param enabled Whether to receive
+ */
+void serialEnable(bool enabled);
+
+/** Read received bytes, blocks the current task until there is one
+ * @return Number of bytes read, at least 1
+ */
+size_t serialRead(void *buffer, size_t length);
+
+/** Send bytes from the controller */
+void serialWrite(const void *buffer, size_t length);
+
+/** Load the data EEPROM from a file, the rest of the EEPROM is erased
+ * @return Whether the file could be read
+ */
+bool loadEeprom(const std::string &path);
+
+} // namespace sim
+
+#endif
@@ -0,0 +1,327 @@
+#include "SimLcd.h"
+
+#include "Sim.h"
+#include "mbed.h"
+
+#include <string>
+
+namespace sim {
+
+namespace {
+
+const int SDA = PA_12;
+const int SCL = PA_11;
+const uint8_t ADDRESS = 0x27;
+
+// PCF8574 port bits
+const uint8_t RS = 0x01;
+const uint8_t RW = 0x02;
+const uint8_t E = 0x04;
+
+// HD44780 execution times in us
+const uint64_t TIME_CLEAR = 1520;
+const uint64_t TIME_COMMAND = 37;
+const uint64_t TIME_DATA = 41;
+
+class Hd44780 {
+public:
+  Hd44780()
+      : _pins(0xff), _fourBit(false), _haveHigh(false), _high(0), _ac(0),
+        _cgram(false), _increment(true), _busyUntil(0), _readHigh(true),
+        _out(0) {
+    memset(_ddram, ' ', sizeof(_ddram));
+    memset(_cgramData, 0, sizeof(_cgramData));
+  }
+
+  // The port expander outputs changed
+  void port(uint8_t pins) {
+    uint8_t old = _pins;
+    _pins = pins;
+    if (pins & RW) {
+      if (!(old & E) && (pins & E))
+        readNibble();
+    } else if ((old & E) && !(pins & E)) {
+      writeNibble(pins >> 4, pins & RS);
+    }
+  }
+
+  // Data lines D7..D4 as driven by the controller, 0xf if not driving
+  uint8_t lines() const {
+    return (_pins & RW) && (_pins & E) ? _out : 0xf;
+  }
+
+private:
+  void writeNibble(uint8_t nibble, bool rs) {
+    _readHigh = true;
+    if (!_fourBit) {
+      execute(nibble << 4, rs);
+    } else if (!_haveHigh) {
+      _high = nibble;
+      _haveHigh = true;
+    } else {
+      _haveHigh = false;
+      execute((_high << 4) | nibble, rs);
+    }
+  }
+
+  void readNibble() {
+    bool rs = _pins & RS;
+    if (_readHigh) {
+      if (rs)
+        _read = _cgram ? _cgramData[_ac & 0x3f] : _ddram[_ac & 0x7f];
+      else
+        _read = (now() < _busyUntil ? 0x80 : 0) | (_ac & 0x7f);
+      _out = _read >> 4;
+    } else {
+      _out = _read & 0xf;
+      if (rs)
+        moveAddress();
+    }
+    _readHigh = !_readHigh;
+  }
+
+  void execute(uint8_t b, bool rs) {
+    if (rs) {
+      if (_cgram)
+        _cgramData[_ac & 0x3f] = b;
+      else
+        _ddram[_ac & 0x7f] = b;
+      moveAddress();
+      _busyUntil = now() + TIME_DATA;
+      show();
+      return;
+    }
+    _busyUntil = now() + TIME_COMMAND;
+    if (b & 0x80) {
+      _ac = b & 0x7f;
+      _cgram = false;
+    } else if (b & 0x40) {
+      _ac = b & 0x3f;
+      _cgram = true;
+    } else if (b & 0x20) {
+      _fourBit = !(b & 0x10);
+    } else if (b & 0x04) {
+      _increment = b & 0x02;
+    } else if (b & 0x02) {
+      _ac = 0;
+      _cgram = false;
+      _busyUntil = now() + TIME_CLEAR;
+    } else if (b & 0x01) {
+      memset(_ddram, ' ', sizeof(_ddram));
+      _ac = 0;
+      _cgram = false;
+      _increment = true;
+      _busyUntil = now() + TIME_CLEAR;
+      show();
+    }
+  }
+
+  void moveAddress() {
+    if (_cgram)
+      _ac = (_ac + (_increment ? 1 : -1)) & 0x3f;
+    else
+      _ac = (_ac + (_increment ? 1 : -1)) & 0x7f;
+  }
+
+  // Record the visible text if it changed
+  void show() {
+    std::string text = "\"";
+    for (int row = 0; row < 2; row++) {
+      if (row)
+        text += '|';
+      for (int col = 0; col < 16; col++) {
+        uint8_t c = _ddram[row * 0x40 + col];
+        if (c < 0x10)
+          text += glyph(c);
+        else
+          text += c >= 0x20 && c < 0x7f && c != '"' ? (char)c : '?';
+      }
+    }
+    text += '"';
+    if (text != _shown) {
+      _shown = text;
+      record("lcd", text);
+    }
+  }
+
+  // A custom character as the number of pixel columns it lights
+  char glyph(uint8_t c) const {
+    uint8_t columns = 0;
+    for (int row = 0; row < 8; row++)
+      columns |= _cgramData[(c & 0x07) * 8 + row];
+    int count = 0;
+    for (int bit = 0; bit < 5; bit++)
+      count += columns >> bit & 1;
+    return '0' + count;
+  }
+
+  uint8_t _pins;
+  bool _fourBit;
+  bool _haveHigh;
+  uint8_t _high;
+  uint8_t _ac;
+  bool _cgram;
+  bool _increment;
+  uint8_t _ddram[128];
+  uint8_t _cgramData[64];
+  uint64_t _busyUntil;
+  bool _readHigh;
+  uint8_t _read;
+  uint8_t _out;
+  std::string _shown;
+};
+
+// I2C slave decoder. Changes the slave makes after a falling clock edge are
+// applied with the next action of the master, like the hold time of a real
+// slave, so the master still sees its ACK right after the clock edge.
+class Bus {
+public:
+  Bus()
+      : _sdaReleased(true), _sclReleased(true), _sdaLow(false), _pending(-1),
+        _state(IDLE), _clocks(0), _shift(0), _tx(0), _masterAck(false),
+        _latch(0xff), _stats() {}
+
+  void drive(int pin, bool released) {
+    if (_pending >= 0) {
+      _sdaLow = _pending;
+      _pending = -1;
+    }
+    int sda = this->sda();
+    int scl = this->scl();
+    if (pin == SDA)
+      _sdaReleased = released;
+    else
+      _sclReleased = released;
+    if (scl && this->scl()) {
+      if (sda && !this->sda())
+        start();
+      else if (!sda && this->sda())
+        stop();
+    } else if (!scl && this->scl()) {
+      clockHigh();
+    } else if (scl && !this->scl()) {
+      clockLow();
+    }
+  }
+
+  int sda() const { return _sdaReleased && !_sdaLow; }
+  int scl() const { return _sclReleased; }
+  const BusStats &stats() const { return _stats; }
+
+private:
+  enum State { IDLE, ADDRESS, WRITE, READ, IGNORE };
+
+  void start() {
+    _stats.transfers++;
+    _state = ADDRESS;
+    _clocks = 0;
+    _shift = 0;
+    _sdaLow = false;
+  }
+
+  void stop() {
+    _state = IDLE;
+    _sdaLow = false;
+  }
+
+  void clockHigh() {
+    _stats.clocks++;
+    if (_clocks == 8 && _state != IDLE && _state != IGNORE)
+      _stats.bytes++;
+    if (_state == ADDRESS || _state == WRITE) {
+      if (_clocks < 8)
+        _shift = (_shift << 1) | sda();
+      _clocks++;
+    } else if (_state == READ) {
+      _clocks++;
+      if (_clocks == 9)
+        _masterAck = !sda();
+    }
+  }
+
+  void clockLow() {
+    if (_state == ADDRESS || _state == WRITE) {
+      if (_clocks == 8) {
+        if (_state == ADDRESS && (_shift >> 1) != ADDRESS) {
+          _state = IGNORE;
+          return;
+        }
+        if (_state == WRITE)
+          write(_shift);
+        _pending = 1;
+      } else if (_clocks == 9) {
+        _clocks = 0;
+        if (_state == ADDRESS && (_shift & 1)) {
+          _state = READ;
+          transmit();
+        } else {
+          _state = WRITE;
+          _pending = 0;
+        }
+        _shift = 0;
+      }
+    } else if (_state == READ) {
+      if (_clocks < 8) {
+        _pending = !((_tx >> (7 - _clocks)) & 1);
+      } else if (_clocks == 8) {
+        _pending = 0;
+      } else {
+        _clocks = 0;
+        if (_masterAck)
+          transmit();
+        else
+          _state = IGNORE;
+      }
+    }
+  }
+
+  void write(uint8_t byte) {
+    _latch = byte;
+    _display.port(byte);
+  }
+
+  // Load the port levels and put the first bit on the bus
+  void transmit() {
+    _tx = (_latch & 0x0f) | ((_latch >> 4) & _display.lines()) << 4;
+    _pending = !(_tx & 0x80);
+  }
+
+  bool _sdaReleased;
+  bool _sclReleased;
+  bool _sdaLow;
+  int _pending;
+  State _state;
+  int _clocks;
+  uint8_t _shift;
+  uint8_t _tx;
+  bool _masterAck;
+  uint8_t _latch;
+  Hd44780 _display;
+  BusStats _stats;
+};
+
+Bus &bus() {
+  static Bus b;
+  return b;
+}
+
+} // namespace
+
+bool busDrive(int pin, bool released) {
+  if (pin != SDA && pin != SCL)
+    return false;
+  bus().drive(pin, released);
+  return true;
+}
+
+BusStats busStats() { return bus().stats(); }
+
+int busLevel(int pin) {
+  if (pin == SDA)
+    return bus().sda();
+  if (pin == SCL)
+    return bus().scl();
+  return -1;
+}
+
+} // namespace sim
@@ -0,0 +1,41 @@
+#ifndef SIM_LCD_H
+#define SIM_LCD_H
+
+#include <stdint.h>
+
+/** Simulated display on the software I2C lines: a PCF8574 port expander at
+ * address 0x27 driving a 2x16 HD44780 controller in 4 bit mode.
+ *
+ * The bus is decoded from the SDA/SCL levels, so the real lcd and
+ * SoftwareI2C drivers run unchanged. The visible text is recorded as signal
+ * "lcd" whenever it changes. Custom characters from the CGRAM show as the
+ * number of pixel columns they light, so a bar graph reads "5552".
+ */
+namespace sim {
+
+/** Set how the controller drives a bus line
+ * @param pin mbed PinName
+ * @param released Whether the open drain output is released (high)
+ * @return Whether the pin is a bus line
+ */
+bool busDrive(int pin, bool released);
+
+/** Level of a bus line as seen by the controller
+ * @param pin mbed PinName
+ * @return Line level, -1 if the pin is no bus line
+ */
+int busLevel(int pin);
+
+/** Traffic on the simulated bus since start-up */
+struct BusStats {
+  uint32_t clocks;    ///< SCL clock pulses, i.e. bit times
+  uint32_t transfers; ///< START conditions
+  uint32_t bytes;     ///< Bytes to and from the port expander, with address
+};
+
+/** Traffic on the simulated bus since start-up */
+BusStats busStats();
+
+} // namespace sim
+
+#endif
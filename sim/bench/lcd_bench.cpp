@@ -0,0 +1,118 @@
+/* Bus load of lcd updates on the simulated display.
+ *
+ * Rewrites the first row with alternating texts, so every cell changes, once
+ * with one I2C transfer per PCF8574 byte as before, once with one
+ * transfer per row and once with the row transfers running in the timer
+ * interrupt, and reports the bus bit times (SCL clock pulses), the time the
+ * calling thread spends busy and the interrupts per character. Then moves
+ * a bar graph across the second row one level at a time, like the ride
+ * gauges, and reports the bus time per update. Clears a full display with
+ * the busy flag polled and with fixed waits. Last measures the SCL
+ * frequency SoftwareI2C delivers for the frequencies of the I2C modes.
+ */
+
+#include "BarGraph.h"
+#include "LCD.h"
+#include "Sim.h"
+#include "SimLcd.h"
+
+namespace {
+
+const int LINES = 20;
+
+void measure(lcd &display, const char *label, bool block, bool async) {
+  display.blockweise(block);
+  display.asynchron(async);
+  sim::BusStats before = sim::busStats();
+  uint64_t cpu = sim::currentTask()->cpuNs();
+  uint64_t interrupts = sim::interrupts();
+  for (int i = 0; i < LINES; i++) {
+    display.locate(0, 0);
+    display.printf(i % 2 ? "ABCDEFGHIJKLMNOP" : "abcdefghijklmnop");
+  }
+  display.asynchron(false); // waits for the last row
+  sim::BusStats after = sim::busStats();
+  double chars = LINES * 16;
+  printf("%-6s %7.1f bit times/char %6.2f transfers/char %6.2f bytes/char "
+         "%7.1f us busy/char %6.1f interrupts/char\n",
+         label, (after.clocks - before.clocks) / chars,
+         (after.transfers - before.transfers) / chars,
+         (after.bytes - before.bytes) / chars,
+         (sim::currentTask()->cpuNs() - cpu) / chars / 1e3,
+         (sim::interrupts() - interrupts) / chars);
+}
+
+// Fills and empties a full row gauge, every level is one update
+void gauge(lcd &display) {
+  const uint32_t UPDATES_PER_SECOND = 4; // TIME_GAUGES of main.cpp
+  display.asynchron(false);
+  for (uint8_t columns = 1; columns <= BarGraph::GLYPHS; columns++)
+    display.zeichen(columns, BarGraph::glyph(columns));
+  BarGraph bar(0x40, BarGraph::MAX_CELLS);
+  sim::BusStats before = sim::busStats();
+  double updates = 0, cells = 0;
+  for (int step = 1; step <= 2 * bar.levels(); step++) {
+    int level = step <= bar.levels() ? step : 2 * bar.levels() - step;
+    uint8_t pos;
+    char text[BarGraph::MAX_CELLS + 1];
+    uint8_t count = bar.set(level, pos, text);
+    display.cursorpos(pos);
+    display.printf("%s", text);
+    cells += count;
+    updates++;
+  }
+  double clocks = (sim::busStats().clocks - before.clocks) / updates;
+  printf("gauge  %7.1f bit times/update %6.2f cells/update %6.2f %% of "
+         "100 kHz at %u updates/s\n",
+         clocks, cells / updates,
+         clocks * UPDATES_PER_SECOND / 100000 * 100,
+         (unsigned)UPDATES_PER_SECOND);
+}
+
+// Time until clear() of a full display returns, flush sends the clear
+// command and waits for it
+void clearing(lcd &display, const char *label, bool poll) {
+  display.asynchron(false);
+  display.busyflag(poll);
+  display.locate(0, 0);
+  display.printf("ABCDEFGHIJKLMNOP");
+  display.locate(0, 1);
+  display.printf("abcdefghijklmnop");
+  sim::BusStats before = sim::busStats();
+  uint64_t start = sim::nowNs();
+  display.clear();
+  printf("clear  %-6s %7.1f us %6u bit times, busy flag %s\n", label,
+         (sim::nowNs() - start) / 1e3,
+         (unsigned)(sim::busStats().clocks - before.clocks),
+         display.busyflag() ? "read" : "off");
+}
+
+// Only writes E=0 to the port expander, the display ignores it
+void frequency(uint32_t hz) {
+  SoftwareI2C bus(PA_12, PA_11);
+  uint8_t idle[64];
+  memset(idle, 0x08, sizeof(idle));
+  bus.setFrequency(hz);
+  sim::BusStats before = sim::busStats();
+  uint64_t start = sim::nowNs();
+  bus.write(0x4e, idle, sizeof(idle));
+  double ns = sim::nowNs() - start;
+  double clocks = sim::busStats().clocks - before.clocks;
+  printf("%7u Hz set %9.0f Hz SCL\n", (unsigned)hz, clocks * 1e9 / ns);
+}
+
+} // namespace
+
+int main() {
+  lcd display;
+  measure(display, "before", false, false);
+  measure(display, "after", true, false);
+  measure(display, "async", true, true);
+  gauge(display);
+  clearing(display, "polled", true);
+  clearing(display, "fixed", false);
+  frequency(100000);
+  frequency(400000);
+  frequency(1000000);
+  return 0;
+}
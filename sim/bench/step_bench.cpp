@@ -0,0 +1,211 @@
+/* Step timing of the controller on the simulated clock.
+ *
+ * Runs the unmodified controller through a script: the three built-in rides
+ * one after the other, a ride switched off while it runs and an emergency
+ * stop. With --axes the first carousels all play the script at once, a
+ * millisecond apart, so their motors share the step timer. Prints the
+ * reports of StepTiming, the interval errors per speed and the latencies of
+ * the inputs, and checks every axis against a limits file, so a regression
+ * fails make.
+ *
+ * Example:
+ *   step_bench --limits bench/step_limits.txt --axes 4 > step_timing.txt
+ *
+ * A limit line is the kind and selector of a report line, a metric and its
+ * upper limit, e.g. "interval speed=50 max_ns 1000". A limit whose report
+ * line is missing fails too, the script must reach every limited speed.
+ */
+
+#include "Sim.h"
+#include "StepTiming.h"
+#include "mbed.h"
+
+#include <unistd.h>
+
+#include <list>
+#include <string>
+#include <vector>
+
+int controller_main();
+void reportStepTiming(Callback<void(const char *)> print);
+
+namespace {
+
+// Inputs as wired in main.cpp, the buttons per carousel
+const PinName ON_OFF[] = {PA_1, PA_0, PA_7, PA_9};
+const PinName ROTATE[] = {PA_6, PA_4, PA_8, PA_5};
+const unsigned MAX_AXES = sizeof(ON_OFF) / sizeof(ON_OFF[0]);
+const PinName EMERGENCY = PA_10;
+const PinName TODDLER = PB_0;
+const PinName KIDS = PB_1;
+const PinName ACTION = PB_2;
+
+const uint64_t SECOND = 1000000;
+const uint64_t PRESS_TIME = 100000;
+const uint64_t AXIS_OFFSET = 1000;
+
+class PinChange : public sim::Event {
+public:
+  PinChange(int pin, int level, uint64_t time) : _pin(pin), _level(level) {
+    schedule(time);
+  }
+
+private:
+  void fire() override { sim::setPinLevel(_pin, _level); }
+  int _pin;
+  int _level;
+};
+
+std::list<PinChange> changes;
+
+void set(PinName pin, int level, uint64_t seconds) {
+  changes.emplace_back(pin, level, seconds * SECOND);
+}
+
+// Press the buttons of the axes one after the other
+void press(const PinName *pins, unsigned axes, uint64_t seconds) {
+  for (unsigned i = 0; i < axes; i++) {
+    uint64_t time = seconds * SECOND + i * AXIS_OFFSET;
+    changes.emplace_back(pins[i], 1, time);
+    changes.emplace_back(pins[i], 0, time + PRESS_TIME);
+  }
+}
+
+// The rides take 3 minutes and ramp down to idle in a few seconds, the mode
+// switches are shared
+uint64_t script(unsigned axes) {
+  set(TODDLER, 1, 0);
+  press(ON_OFF, axes, 1);
+  press(ROTATE, axes, 2);
+  set(TODDLER, 0, 200);
+  set(KIDS, 1, 200);
+  press(ROTATE, axes, 201);
+  set(KIDS, 0, 400);
+  set(ACTION, 1, 400);
+  press(ROTATE, axes, 401);
+  // off while the action ride runs, on again and a second ride
+  press(ON_OFF, axes, 500);
+  press(ON_OFF, axes, 520);
+  press(ROTATE, axes, 521);
+  set(EMERGENCY, 1, 560);
+  return 565 * SECOND;
+}
+
+struct Limit {
+  std::string line; // kind and selector
+  std::string metric;
+  unsigned long value;
+};
+
+std::vector<Limit> limits;
+unsigned axes = 1;
+// report lines per axis
+std::vector<std::vector<std::string>> reports;
+
+void usage() {
+  fprintf(stderr,
+          "usage: step_bench [--limits FILE] [--axes N] [--out FILE]\n");
+  exit(2);
+}
+
+void readLimits(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  char text[128];
+  while (fgets(text, sizeof(text), file)) {
+    char kind[32], selector[32], metric[32];
+    unsigned long value;
+    if (text[0] == '#' || text[0] == '\n')
+      continue;
+    if (sscanf(text, "%31s %31s %31s %lu", kind, selector, metric, &value) !=
+        4) {
+      fprintf(stderr, "%s: bad limit \"%.*s\"\n", path,
+              (int)strcspn(text, "\n"), text);
+      exit(1);
+    }
+    limits.push_back({std::string(kind) + " " + selector, metric, value});
+  }
+  fclose(file);
+}
+
+void collect(const char *line) {
+  printf("%s\n", line);
+  if (strncmp(line, "STEPTIMING ", 11) == 0)
+    reports.emplace_back();
+  if (!reports.empty())
+    reports.back().push_back(line);
+}
+
+// Value of metric in the report line that starts with line
+bool lookup(const std::vector<std::string> &report, const Limit &limit,
+            unsigned long &value) {
+  std::string key = " " + limit.metric + "=";
+  for (const std::string &text : report) {
+    if (text.compare(0, limit.line.size() + 1, limit.line + " ") != 0)
+      continue;
+    size_t at = text.find(key);
+    if (at == std::string::npos)
+      return false;
+    value = strtoul(text.c_str() + at + key.size(), NULL, 10);
+    return true;
+  }
+  return false;
+}
+
+void check() {
+  reportStepTiming(callback(&collect));
+  fflush(stdout);
+  int failed = 0;
+  for (unsigned axis = 0; axis < axes; axis++) {
+    if (axis >= reports.size()) {
+      fprintf(stderr, "FAIL axis %u: no report\n", axis + 1);
+      failed++;
+      continue;
+    }
+    for (const Limit &limit : limits) {
+      unsigned long value;
+      if (!lookup(reports[axis], limit, value)) {
+        fprintf(stderr, "FAIL axis %u %s %s: not measured\n", axis + 1,
+                limit.line.c_str(), limit.metric.c_str());
+        failed++;
+      } else if (value > limit.value) {
+        fprintf(stderr, "FAIL axis %u %s %s=%lu, limit %lu\n", axis + 1,
+                limit.line.c_str(), limit.metric.c_str(), value, limit.value);
+        failed++;
+      }
+    }
+  }
+  if (!limits.empty())
+    fprintf(stderr, "%d of %zu limits exceeded on %u axes\n", failed,
+            limits.size() * axes, axes);
+  _exit(failed ? 1 : 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  sim::setRecordFile("/dev/null");
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    if (option == "--limits")
+      readLimits(argv[++i]);
+    else if (option == "--axes")
+      axes = strtoul(argv[++i], NULL, 10);
+    else if (option == "--out")
+      sim::setRecordFile(argv[++i]);
+    else
+      usage();
+  }
+  if (axes < 1 || axes > MAX_AXES)
+    usage();
+  sim::setDeepSleepWakeup(10000);
+  sim::setEnd(script(axes));
+  sim::atFinish(&check);
+  controller_main();
+  sim::finish();
+}
@@ -0,0 +1,96 @@
+#ifndef SIM_CMSIS_H
+#define SIM_CMSIS_H
+
+/* Host stand-in for the Cortex-M registers the controller uses. The DWT
+ * cycle counter runs from the virtual clock at SystemCoreClock, and every
+ * read of it takes a few cycles of virtual time, so busy-wait loops on it
+ * terminate and cost the time they would on the target.
+ */
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+class SimCycleCounter {
+public:
+  operator uint32_t() const;
+  SimCycleCounter &operator=(uint32_t value);
+};
+
+struct SimDWT {
+  uint32_t CTRL;
+  SimCycleCounter CYCCNT;
+};
+
+struct SimCoreDebug {
+  uint32_t DEMCR;
+};
+
+extern SimDWT sim_dwt;
+extern SimCoreDebug sim_core_debug;
+
+// Interrupts only run while the controller waits, masking has no effect
+#define __CORTEX_M 3
+#define __NVIC_PRIO_BITS 4
+
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline uint32_t __get_BASEPRI() { return 0; }
+inline void __set_BASEPRI(uint32_t) {}
+inline void __set_BASEPRI_MAX(uint32_t) {}
+
+// Interrupts run as if from thread mode, all at one priority
+typedef int32_t IRQn_Type;
+inline uint32_t __get_IPSR() { return 0; }
+inline uint32_t NVIC_GetPriority(IRQn_Type) { return 0; }
+
+// Data EEPROM of the STM32L152RE and the HAL calls that program it
+#define SIM_DATA_EEPROM_SIZE 16384
+extern uint32_t sim_data_eeprom[SIM_DATA_EEPROM_SIZE / 4];
+#define DATA_EEPROM_BASE ((uintptr_t)sim_data_eeprom)
+#define DATA_EEPROM_END (DATA_EEPROM_BASE + SIM_DATA_EEPROM_SIZE - 1)
+#define FLASH_TYPEPROGRAMDATA_WORD 0x02U
+
+typedef enum { HAL_OK, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock();
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock();
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t type,
+                                                 uintptr_t address,
+                                                 uint32_t data);
+
+// GPIO output registers. A store to BSRR sets and resets bits of ODR in
+// one go and records the outputs whose level changed, see mbed.cpp. The
+// last word stored and the number of stores are kept for tests.
+class SimBsrr {
+public:
+  SimBsrr &operator=(uint32_t value);
+
+  uint32_t last() const { return _last; }
+
+  uint32_t stores() const { return _stores; }
+
+private:
+  uint32_t _last;
+  uint32_t _stores;
+};
+
+typedef struct {
+  volatile uint32_t ODR;
+  SimBsrr BSRR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef sim_gpio[8];
+
+#define GPIOA (&sim_gpio[0])
+#define GPIOB (&sim_gpio[1])
+#define GPIOC (&sim_gpio[2])
+#define GPIOD (&sim_gpio[3])
+#define GPIOH (&sim_gpio[7])
+
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+#endif
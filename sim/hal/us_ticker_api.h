@@ -0,0 +1,9 @@
+#ifndef SIM_US_TICKER_API_H
+#define SIM_US_TICKER_API_H
+
+#include <stdint.h>
+
+/** Virtual time in us, truncated to 32 bit like the target's us ticker */
+uint32_t us_ticker_read();
+
+#endif
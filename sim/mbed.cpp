@@ -0,0 +1,125 @@
+#include "mbed.h"
+
+#include "SimLcd.h"
+#include "mbed_stats.h"
+
+uint32_t SystemCoreClock = 32000000;
+
+SimDWT sim_dwt;
+SimCoreDebug sim_core_debug;
+
+namespace {
+
+// Virtual time one register or function access takes on the target
+const uint64_t ACCESS_CYCLES = 4;
+
+uint32_t cycleOffset;
+
+uint64_t cycleTime() { return sim::nowNs() * SystemCoreClock / 1000000000; }
+
+} // namespace
+
+SimCycleCounter::operator uint32_t() const {
+  sim::advanceNs(ACCESS_CYCLES * 1000000000 / SystemCoreClock);
+  return (uint32_t)cycleTime() - cycleOffset;
+}
+
+SimCycleCounter &SimCycleCounter::operator=(uint32_t value) {
+  cycleOffset = (uint32_t)cycleTime() - value;
+  return *this;
+}
+
+uint32_t us_ticker_read() {
+  sim::advanceNs(ACCESS_CYCLES * 1000000000 / SystemCoreClock);
+  return (uint32_t)sim::now();
+}
+
+GPIO_TypeDef sim_gpio[8];
+
+namespace {
+
+// Bits of every output, recorded as signal Port<port>:<mask>. Function
+// local, the controller's global objects register from their constructors.
+std::vector<uint32_t> &outputs(int port) {
+  static std::vector<uint32_t> masks[8];
+  return masks[port];
+}
+
+// Record the outputs of a port whose level differs from old
+void recordOutputs(int port, uint32_t old) {
+  uint32_t odr = sim_gpio[port].ODR;
+  for (uint32_t mask : outputs(port)) {
+    if ((odr & mask) != (old & mask)) {
+      char signal[24], text[12];
+      snprintf(signal, sizeof(signal), "Port%c:0x%x", "ABCDEFGH"[port], mask);
+      snprintf(text, sizeof(text), "0x%x", odr & mask);
+      sim::record(signal, text);
+    }
+  }
+}
+
+} // namespace
+
+SimBsrr &SimBsrr::operator=(uint32_t value) {
+  GPIO_TypeDef *gpio =
+      (GPIO_TypeDef *)((char *)this - offsetof(GPIO_TypeDef, BSRR));
+  int port = gpio - sim_gpio;
+  uint32_t old = gpio->ODR;
+  _last = value;
+  _stores++;
+  // set wins over reset like on the STM32
+  gpio->ODR = (old & ~(value >> 16)) | (value & 0xffff);
+  recordOutputs(port, old);
+  return *this;
+}
+
+void port_init(port_t *obj, PortName port, int mask, PinDirection dir) {
+  obj->port = port;
+  obj->mask = mask;
+  if (dir == PIN_OUTPUT)
+    outputs(port).push_back(mask);
+}
+
+namespace mbed {
+
+void PortOut::write(int value) {
+  uint32_t old = sim_gpio[_port].ODR;
+  sim_gpio[_port].ODR = (old & ~_mask) | (value & _mask);
+  recordOutputs(_port, old);
+}
+
+int PortOut::read() { return sim_gpio[_port].ODR & _mask; }
+
+void DigitalInOut::drive() { sim::busDrive(_pin, !_output || _value); }
+
+int DigitalInOut::read() {
+  int level = sim::busLevel(_pin);
+  return level >= 0 ? level : sim::pinLevel(_pin, _output ? _value : 0);
+}
+
+} // namespace mbed
+
+size_t mbed_stats_thread_get_each(mbed_stats_thread_t *stats, size_t count) {
+  std::vector<sim::Task *> tasks = sim::tasks();
+  size_t i = 0;
+  for (sim::Task *task : tasks) {
+    if (i == count)
+      break;
+    stats[i].id = i + 1;
+    stats[i].state = 0;
+    stats[i].priority = task->priority();
+    stats[i].stack_size = task->stackSize();
+    stats[i].stack_space = task->stackSize() - task->stackUsed();
+    stats[i].name = task->name();
+    i++;
+  }
+  return i;
+}
+
+void mbed_stats_cpu_get(mbed_stats_cpu_t *stats) {
+  sim::PowerStats power = sim::powerStats();
+  stats->uptime = sim::now();
+  stats->sleep_time = power.sleepNs / 1000;
+  stats->deep_sleep_time = power.deepSleepNs / 1000;
+  stats->idle_time = stats->sleep_time + stats->deep_sleep_time;
+}
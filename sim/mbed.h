@@ -0,0 +1,583 @@
+#ifndef SIM_MBED_H
+#define SIM_MBED_H
+
+/* Host stand-in for the parts of mbed-os used by the controller. The classes
+ * keep the mbed interfaces but run on the virtual clock of Sim.h.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "Sim.h"
+#include "SimDevice.h"
+#include "cmsis.h"
+#include "hal/us_ticker_api.h"
+
+using namespace std::chrono_literals;
+
+// Pins and ports of the STM32, PinName is port * 16 + pin like on the target
+enum PortName { PortA, PortB, PortC, PortD, PortH = 7 };
+
+#define SIM_PORT_PINS(port, base)                                              \
+  P##port##_0 = base, P##port##_1, P##port##_2, P##port##_3, P##port##_4,      \
+  P##port##_5, P##port##_6, P##port##_7, P##port##_8, P##port##_9,             \
+  P##port##_10, P##port##_11, P##port##_12, P##port##_13, P##port##_14,        \
+  P##port##_15
+
+enum PinName {
+  SIM_PORT_PINS(A, 0x00),
+  SIM_PORT_PINS(B, 0x10),
+  SIM_PORT_PINS(C, 0x20),
+  USBTX = PA_2,
+  USBRX = PA_3,
+  NC = -1
+};
+
+enum PinMode { PullNone, PullUp, PullDown, OpenDrain, PullDefault = PullNone };
+
+enum PinDirection { PIN_INPUT, PIN_OUTPUT };
+
+// Port HAL, port_init() of outputs registers their bits for recording
+struct port_t {
+  PortName port;
+  uint32_t mask;
+};
+
+void port_init(port_t *obj, PortName port, int mask, PinDirection dir);
+
+// Interrupts only run while the controller waits, there is nothing to mask
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+inline void sleep_manager_lock_deep_sleep() { sim::lockDeepSleep(); }
+inline void sleep_manager_unlock_deep_sleep() { sim::unlockDeepSleep(); }
+inline bool sleep_manager_can_deep_sleep() { return sim::canDeepSleep(); }
+
+namespace mbed {
+
+template <typename F> class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)> : public std::function<R(Args...)> {
+public:
+  Callback() {}
+  Callback(std::nullptr_t) {}
+  Callback(R (*func)(Args...)) : std::function<R(Args...)>(func) {}
+  template <typename T, typename U>
+  Callback(U *obj, R (T::*method)(Args...))
+      : std::function<R(Args...)>(
+            [obj, method](Args... args) { return (obj->*method)(args...); }) {
+  }
+  template <typename T, typename U>
+  Callback(R (*func)(T *, Args...), U *arg)
+      : std::function<R(Args...)>(
+            [func, arg](Args... args) { return func(arg, args...); }) {}
+};
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(Args...)) {
+  return Callback<R(Args...)>(func);
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U *obj, R (T::*method)(Args...)) {
+  return Callback<R(Args...)>(obj, method);
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(T *, Args...), U *arg) {
+  return Callback<R(Args...)>(func, arg);
+}
+
+/** Clock of the timer drivers, counts virtual us since start-up */
+struct TickerDataClock {
+  typedef std::chrono::microseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<TickerDataClock> time_point;
+  static const bool is_steady = true;
+  static time_point now() { return time_point(duration(sim::now())); }
+};
+
+typedef TickerDataClock HighResClock;
+
+// Like in mbed-os, the us ticker keeps the controller out of deep sleep
+// while a Timeout or Ticker is attached
+class TimerEvent : private sim::Event {
+public:
+  TimerEvent() : _locked(false) {}
+  virtual ~TimerEvent() { unlock(); }
+
+  /** Time the event is or was last scheduled for */
+  TickerDataClock::time_point scheduled_time() const {
+    return TickerDataClock::time_point(std::chrono::microseconds(time()));
+  }
+
+protected:
+  void insert_absolute(TickerDataClock::time_point time) {
+    if (!_locked)
+      sleep_manager_lock_deep_sleep();
+    _locked = true;
+    schedule(time.time_since_epoch().count());
+  }
+  void remove() {
+    cancel();
+    unlock();
+  }
+  virtual void handler() = 0;
+
+private:
+  void fire() override {
+    handler();
+    if (!scheduled())
+      unlock();
+  }
+  void unlock() {
+    if (_locked)
+      sleep_manager_unlock_deep_sleep();
+    _locked = false;
+  }
+  bool _locked;
+};
+
+class Timeout : public TimerEvent {
+public:
+  void attach(Callback<void()> func, std::chrono::microseconds t) {
+    attach_absolute(func, TickerDataClock::now() + t);
+  }
+  void attach_absolute(Callback<void()> func,
+                       TickerDataClock::time_point abs_time) {
+    _function = func;
+    insert_absolute(abs_time);
+  }
+  void detach() {
+    remove();
+    _function = nullptr;
+  }
+
+protected:
+  void handler() override {
+    Callback<void()> function = _function;
+    if (function)
+      function();
+  }
+
+private:
+  Callback<void()> _function;
+};
+
+class Ticker : public TimerEvent {
+public:
+  void attach(Callback<void()> func, std::chrono::microseconds t) {
+    _function = func;
+    _period = t;
+    insert_absolute(TickerDataClock::now() + t);
+  }
+  void detach() {
+    remove();
+    _function = nullptr;
+  }
+
+protected:
+  void handler() override {
+    insert_absolute(scheduled_time() + _period);
+    if (_function)
+      _function();
+  }
+
+private:
+  Callback<void()> _function;
+  std::chrono::microseconds _period;
+};
+
+// Keeps the controller out of deep sleep while running, like in mbed-os
+class Timer {
+public:
+  Timer() : _running(false), _start(0), _elapsed(0) {}
+  ~Timer() { stop(); }
+  void start() {
+    if (!_running) {
+      _start = sim::now();
+      _running = true;
+      sleep_manager_lock_deep_sleep();
+    }
+  }
+  void stop() {
+    _elapsed = elapsed();
+    if (_running)
+      sleep_manager_unlock_deep_sleep();
+    _running = false;
+  }
+  void reset() {
+    _start = sim::now();
+    _elapsed = 0;
+  }
+  std::chrono::microseconds elapsed_time() const {
+    return std::chrono::microseconds(elapsed());
+  }
+
+private:
+  uint64_t elapsed() const {
+    return _running ? _elapsed + sim::now() - _start : _elapsed;
+  }
+  bool _running;
+  uint64_t _start;
+  uint64_t _elapsed;
+};
+
+class DigitalIn {
+public:
+  DigitalIn(PinName pin) : _pin(pin), _pull(PullNone) {}
+  DigitalIn(PinName pin, PinMode mode) : _pin(pin), _pull(mode) {}
+  void mode(PinMode pull) { _pull = pull; }
+  int read() { return sim::pinLevel(_pin, _pull == PullUp); }
+  operator int() { return read(); }
+
+private:
+  PinName _pin;
+  PinMode _pull;
+};
+
+class PortIn {
+public:
+  PortIn(PortName port, int mask = 0xFFFFFFFF)
+      : _port(port), _mask(mask), _pull(PullNone) {}
+  void mode(PinMode pull) { _pull = pull; }
+  int read() {
+    int value = 0;
+    for (int pin = 0; pin < 16; pin++) {
+      if (_mask & 1 << pin)
+        value |= sim::pinLevel(_port * 16 + pin, _pull == PullUp) << pin;
+    }
+    return value;
+  }
+  operator int() { return read(); }
+
+private:
+  PortName _port;
+  int _mask;
+  PinMode _pull;
+};
+
+// Only used for the software I2C lines, which go to the simulated display
+class DigitalInOut {
+public:
+  DigitalInOut(PinName pin) : _pin(pin), _output(false), _value(1) {
+    drive();
+  }
+  void output() {
+    _output = true;
+    drive();
+  }
+  void input() {
+    _output = false;
+    drive();
+  }
+  void mode(PinMode) {}
+  void write(int value) {
+    _value = value != 0;
+    drive();
+  }
+  int read();
+  DigitalInOut &operator=(int value) {
+    write(value);
+    return *this;
+  }
+  operator int() { return read(); }
+
+private:
+  void drive();
+  PinName _pin;
+  bool _output;
+  int _value;
+};
+
+class InterruptIn : private sim::PinListener {
+public:
+  InterruptIn(PinName pin) : _pin(pin), _pull(PullNone), _enabled(true) {
+    _level = read();
+    sim::listenPin(_pin, this);
+  }
+  ~InterruptIn() { sim::unlistenPin(_pin, this); }
+  void mode(PinMode pull) {
+    _pull = pull;
+    _level = read();
+  }
+  void rise(Callback<void()> func) { _rise = func; }
+  void fall(Callback<void()> func) { _fall = func; }
+  void enable_irq() { _enabled = true; }
+  void disable_irq() { _enabled = false; }
+  int read() { return sim::pinLevel(_pin, _pull == PullUp); }
+  operator int() { return read(); }
+
+private:
+  void pinChanged(int) override {
+    int level = read();
+    if (level == _level)
+      return;
+    _level = level;
+    Callback<void()> &func = level ? _rise : _fall;
+    if (_enabled && func)
+      func();
+  }
+  PinName _pin;
+  PinMode _pull;
+  bool _enabled;
+  int _level;
+  Callback<void()> _rise;
+  Callback<void()> _fall;
+};
+
+class PortOut {
+public:
+  PortOut(PortName port, int mask = 0xFFFFFFFF) : _port(port), _mask(mask) {
+    port_t obj;
+    port_init(&obj, port, mask, PIN_OUTPUT);
+  }
+  void write(int value);
+  int read();
+  PortOut &operator=(int value) {
+    write(value);
+    return *this;
+  }
+  PortOut &operator=(PortOut &rhs) {
+    write(rhs.read());
+    return *this;
+  }
+  operator int() { return read(); }
+
+private:
+  PortName _port;
+  int _mask;
+};
+
+// The serial port to the host, see SimDevice.h. The receiver keeps the
+// controller out of deep sleep while enabled, like in mbed-os.
+class BufferedSerial {
+public:
+  BufferedSerial(PinName tx, PinName rx, int baud = 9600) : _input(true) {
+    sim::serialOpen(baud);
+    sleep_manager_lock_deep_sleep();
+  }
+  ~BufferedSerial() { enable_input(false); }
+  int enable_input(bool enabled) {
+    if (enabled != _input) {
+      _input = enabled;
+      sim::serialEnable(enabled);
+      if (enabled)
+        sleep_manager_lock_deep_sleep();
+      else
+        sleep_manager_unlock_deep_sleep();
+    }
+    return 0;
+  }
+  ssize_t read(void *buffer, size_t length) {
+    return sim::serialRead(buffer, length);
+  }
+  ssize_t write(const void *buffer, size_t length) {
+    sim::serialWrite(buffer, length);
+    return length;
+  }
+
+private:
+  bool _input;
+};
+
+// Events of I2C::transfer
+#define I2C_EVENT_ERROR (1 << 1)
+#define I2C_EVENT_ERROR_NO_SLAVE (1 << 2)
+#define I2C_EVENT_TRANSFER_COMPLETE (1 << 3)
+#define I2C_EVENT_TRANSFER_EARLY_NACK (1 << 4)
+#define I2C_EVENT_ALL                                                          \
+  (I2C_EVENT_ERROR | I2C_EVENT_TRANSFER_COMPLETE | I2C_EVENT_ERROR_NO_SLAVE |  \
+   I2C_EVENT_TRANSFER_EARLY_NACK)
+
+typedef Callback<void(int)> event_callback_t;
+
+// The I2C peripheral, so HardwareI2C compiles on the host. No peripheral is
+// simulated: nothing acknowledges, transfers end at once with
+// I2C_EVENT_ERROR_NO_SLAVE. The simulated display is on the software I2C
+// pins, see SimLcd.h.
+class I2C {
+public:
+  I2C(PinName sda, PinName scl) {}
+  void frequency(int hz) {}
+  int read(int address, char *data, int length, bool repeated = false) {
+    memset(data, 0xff, length);
+    return -1;
+  }
+  int write(int address, const char *data, int length, bool repeated = false) {
+    return -1;
+  }
+  int transfer(int address, const char *tx_buffer, int tx_length,
+               char *rx_buffer, int rx_length, const event_callback_t &callback,
+               int event = I2C_EVENT_TRANSFER_COMPLETE, bool repeated = false) {
+    if (callback && (event & I2C_EVENT_ERROR_NO_SLAVE))
+      callback(I2C_EVENT_ERROR_NO_SLAVE);
+    return 0;
+  }
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+inline void wait_us(int us) { sim::advance(us); }
+
+inline void wait_ns(unsigned int ns) { sim::advanceNs(ns); }
+
+// Thread priorities and stack size of CMSIS-RTOS2 / mbed-os
+enum osPriority {
+  osPriorityIdle = 1,
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40,
+  osPriorityRealtime = 48
+};
+
+typedef int32_t osStatus;
+const osStatus osOK = 0;
+
+#define OS_STACK_SIZE 4096
+#define osWaitForever 0xFFFFFFFFU
+#define osFlagsError 0x80000000U
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+
+inline bool core_util_is_isr_active() { return sim::inInterrupt(); }
+
+// Checked in the simulation as in a debug build
+#define MBED_ASSERT(expr)                                                      \
+  do {                                                                         \
+    if (!(expr)) {                                                             \
+      fprintf(stderr, "assertion failed %s:%d: %s\n", __FILE__, __LINE__,    \
+              #expr);                                                          \
+      abort();                                                                 \
+    }                                                                          \
+  } while (0)
+
+namespace rtos {
+
+// RTOS kernel tick, runs from the low power ticker in deep sleep
+namespace Kernel {
+
+struct Clock {
+  typedef std::chrono::milliseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<Clock> time_point;
+  typedef std::chrono::duration<uint32_t, std::milli> duration_u32;
+  static const bool is_steady = true;
+  static time_point now() { return time_point(duration(sim::now() / 1000)); }
+};
+
+} // namespace Kernel
+
+namespace ThisThread {
+
+inline void sleep_for(std::chrono::milliseconds rel_time) {
+  uint64_t end = sim::nowNs() + rel_time.count() * 1000000ull;
+  while (sim::nowNs() < end)
+    sim::block(end - sim::nowNs());
+}
+
+inline uint32_t flags_get() { return sim::currentTask()->flags(); }
+
+inline uint32_t flags_clear(uint32_t flags) {
+  return sim::currentTask()->clearFlags(flags);
+}
+
+inline uint32_t flags_wait_any(uint32_t flags, bool clear = true) {
+  sim::Task *task = sim::currentTask();
+  while (!(task->flags() & flags))
+    sim::block(UINT64_MAX);
+  uint32_t result = task->flags();
+  if (clear)
+    task->clearFlags(flags);
+  return result;
+}
+
+} // namespace ThisThread
+
+class Thread : private sim::Task {
+public:
+  Thread(osPriority priority = osPriorityNormal,
+         uint32_t stack_size = OS_STACK_SIZE, unsigned char *stack_mem = NULL,
+         const char *name = NULL)
+      : sim::Task(priority, name), _stack_size(stack_size), _name(name) {}
+  osStatus start(mbed::Callback<void()> task) {
+    _task = task;
+    sim::Task::start();
+    return osOK;
+  }
+  uint32_t flags_set(uint32_t flags) { return setFlags(flags); }
+  uint32_t stack_size() const { return _stack_size; }
+  const char *get_name() const { return _name; }
+
+private:
+  void run() override { _task(); }
+  mbed::Callback<void()> _task;
+  uint32_t _stack_size;
+  const char *_name;
+};
+
+class EventFlags {
+public:
+  EventFlags() : _flags(0) {}
+  uint32_t set(uint32_t flags) {
+    _flags |= flags;
+    std::vector<sim::Task *> waiters;
+    waiters.swap(_waiters);
+    for (sim::Task *task : waiters)
+      task->wake();
+    return _flags;
+  }
+  uint32_t clear(uint32_t flags = 0x7fffffff) {
+    uint32_t result = _flags;
+    _flags &= ~flags;
+    return result;
+  }
+  uint32_t get() const { return _flags; }
+  uint32_t wait_any(uint32_t flags, uint32_t millisec = osWaitForever,
+                    bool clear = true) {
+    uint64_t end = sim::nowNs() + millisec * 1000000ull;
+    while (!(_flags & flags)) {
+      if (millisec != osWaitForever && sim::nowNs() >= end)
+        return osFlagsErrorTimeout;
+      _waiters.push_back(sim::currentTask());
+      sim::block(millisec == osWaitForever ? UINT64_MAX
+                                           : end - sim::nowNs());
+    }
+    uint32_t result = _flags;
+    if (clear)
+      _flags &= ~flags;
+    return result;
+  }
+  uint32_t wait_any_for(uint32_t flags, Kernel::Clock::duration_u32 rel_time,
+                        bool clear = true) {
+    return wait_any(flags, rel_time.count(), clear);
+  }
+
+private:
+  uint32_t volatile _flags;
+  std::vector<sim::Task *> _waiters;
+};
+
+} // namespace rtos
+
+inline void thread_sleep_for(uint32_t millisec) {
+  rtos::ThisThread::sleep_for(std::chrono::milliseconds(millisec));
+}
+
+using namespace rtos;
+
+#endif
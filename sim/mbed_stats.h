@@ -0,0 +1,38 @@
+#ifndef SIM_MBED_STATS_H
+#define SIM_MBED_STATS_H
+
+/* Host stand-in for the thread and CPU statistics of mbed-os, taken from the
+ * tasks and the power model of Sim.h. Stack numbers are those of the host
+ * stacks.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBED_THREAD_STATS_ENABLED 1
+#define MBED_STACK_STATS_ENABLED 1
+#define MBED_CPU_STATS_ENABLED 1
+
+typedef uint64_t us_timestamp_t;
+
+typedef struct {
+  uint32_t id;
+  uint32_t state;
+  uint32_t priority;
+  uint32_t stack_size;
+  uint32_t stack_space; // least free stack so far
+  const char *name;
+} mbed_stats_thread_t;
+
+typedef struct {
+  us_timestamp_t uptime;
+  us_timestamp_t idle_time;
+  us_timestamp_t sleep_time;
+  us_timestamp_t deep_sleep_time;
+} mbed_stats_cpu_t;
+
+size_t mbed_stats_thread_get_each(mbed_stats_thread_t *stats, size_t count);
+
+void mbed_stats_cpu_get(mbed_stats_cpu_t *stats);
+
+#endif
@@ -0,0 +1,184 @@
+/* Host tool for ride images of the data EEPROM.
+ *
+ * Packs a text description of the rides into the binary image the
+ * controller checks at boot, and dumps an image back as text.
+ *
+ * Example:
+ *   ride_tool pack rides.txt rides.bin
+ *   cat rides.bin > /dev/ttyACM0
+ *
+ * The text has one "ride NAME" line per ride, in the order of the mode
+ * inputs, followed by its segments: time from the start of the ride with
+ * unit ms, s or min, speed in half steps/s, jump or ramp, and optionally the
+ * text for display row 0 in double quotes. # starts a comment.
+ */
+
+#include "RideFormat.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// MOTOR_STOP of main.cpp, the speed the last segment of every ride has
+const uint16_t STOP = 40;
+
+void usage() {
+  fprintf(stderr, "usage: ride_tool pack RIDES IMAGE\n"
+                  "       ride_tool dump IMAGE\n");
+  exit(2);
+}
+
+void fail(const std::string &path, int line, const char *error) {
+  fprintf(stderr, "%s:%d: %s\n", path.c_str(), line, error);
+  exit(1);
+}
+
+bool parseTime(const std::string &text, uint32_t &ms) {
+  char *unit;
+  double value = strtod(text.c_str(), &unit);
+  std::string u(unit);
+  if (u == "ms")
+    ms = value;
+  else if (u == "s")
+    ms = value * 1e3;
+  else if (u == "min")
+    ms = value * 60e3;
+  else
+    return false;
+  return unit != text.c_str();
+}
+
+// Split a line into words, a double quoted word may contain spaces
+std::vector<std::string> split(const std::string &line) {
+  std::vector<std::string> words;
+  size_t i = 0;
+  while (i < line.size()) {
+    if (line[i] == '#')
+      break;
+    if (isspace((unsigned char)line[i])) {
+      i++;
+    } else if (line[i] == '"') {
+      size_t end = line.find('"', i + 1);
+      if (end == std::string::npos)
+        end = line.size();
+      words.push_back(line.substr(i, end - i));
+      i = end + 1;
+    } else {
+      size_t start = i;
+      while (i < line.size() && !isspace((unsigned char)line[i]))
+        i++;
+      words.push_back(line.substr(start, i - start));
+    }
+  }
+  return words;
+}
+
+int pack(const std::string &in, const std::string &out) {
+  FILE *file = fopen(in.c_str(), "r");
+  if (file == NULL) {
+    perror(in.c_str());
+    return 1;
+  }
+  std::vector<rideformat::Entry> entries;
+  std::vector<RideSegment> segments;
+  char buffer[256];
+  for (int n = 1; fgets(buffer, sizeof(buffer), file); n++) {
+    std::vector<std::string> words = split(buffer);
+    if (words.empty())
+      continue;
+    if (words[0] == "ride") {
+      entries.push_back(rideformat::Entry{(uint16_t)segments.size(), 0});
+      continue;
+    }
+    if (entries.empty())
+      fail(in, n, "segment before the first ride");
+    uint32_t ms;
+    if (words.size() < 3 || words.size() > 4 || !parseTime(words[0], ms))
+      fail(in, n, "expected: TIME SPEED jump|ramp [\"TEXT\"]");
+    if (words[2] != "jump" && words[2] != "ramp")
+      fail(in, n, "ramp must be jump or ramp");
+    std::string text = words.size() == 4 ? words[3].substr(1) : "";
+    if (text.size() > 16)
+      fail(in, n, "text longer than 16 characters");
+    RideSegment segment = rideSegment(
+        std::chrono::milliseconds(ms), atoi(words[1].c_str()),
+        words[2] == "jump" ? RIDE_JUMP : RIDE_RAMP, text.c_str());
+    segments.push_back(segment);
+    entries.back().count++;
+  }
+  fclose(file);
+
+  std::vector<uint8_t> image(sizeof(rideformat::Header));
+  image.insert(image.end(), (const uint8_t *)entries.data(),
+               (const uint8_t *)(entries.data() + entries.size()));
+  image.insert(image.end(), (const uint8_t *)segments.data(),
+               (const uint8_t *)(segments.data() + segments.size()));
+  rideformat::Header header;
+  header.magic = rideformat::MAGIC;
+  header.version = rideformat::VERSION;
+  header.rides = entries.size();
+  header.length = image.size() - sizeof(header);
+  header.crc = rideformat::crc32(image.data() + sizeof(header), header.length);
+  memcpy(image.data(), &header, sizeof(header));
+  const char *error = rideformat::check(image.data(), image.size(), STOP);
+  if (error)
+    fail(in, 0, error);
+
+  file = fopen(out.c_str(), "wb");
+  if (file == NULL || fwrite(image.data(), 1, image.size(), file) !=
+                          image.size()) {
+    perror(out.c_str());
+    return 1;
+  }
+  fclose(file);
+  printf("%zu rides, %zu segments, %zu bytes\n", entries.size(),
+         segments.size(), image.size());
+  return 0;
+}
+
+int dump(const std::string &in) {
+  FILE *file = fopen(in.c_str(), "rb");
+  if (file == NULL) {
+    perror(in.c_str());
+    return 1;
+  }
+  std::vector<uint32_t> image(rideformat::MAX_SIZE / 4);
+  size_t size = fread(image.data(), 1, rideformat::MAX_SIZE, file);
+  fclose(file);
+  const char *error = rideformat::check(image.data(), size, STOP);
+  if (error)
+    fail(in, 0, error);
+  const rideformat::Header *header = (const rideformat::Header *)image.data();
+  const rideformat::Entry *entries = rideformat::entries(image.data());
+  const RideSegment *segments = rideformat::segments(image.data());
+  printf("# version %u, %u bytes, crc %08x\n", header->version,
+         (unsigned)(sizeof(*header) + header->length), header->crc);
+  for (uint16_t ride = 0; ride < header->rides; ride++) {
+    printf("ride %u\n", ride);
+    for (uint16_t i = 0; i < entries[ride].count; i++) {
+      const RideSegment &segment = segments[entries[ride].first + i];
+      printf("%ums %u %s", segment.offsetMs, segment.speed,
+             segment.ramp == RIDE_JUMP ? "jump" : "ramp");
+      if (segment.text[0])
+        printf(" \"%s\"", segment.text);
+      printf("\n");
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc == 4 && strcmp(argv[1], "pack") == 0)
+    return pack(argv[2], argv[3]);
+  if (argc == 3 && strcmp(argv[1], "dump") == 0)
+    return dump(argv[2]);
+  usage();
+}
@@ -0,0 +1,202 @@
+/* Host simulation of the carousel controller.
+ *
+ * Runs the unmodified controller main() on a virtual clock and writes every
+ * port output and display change with its virtual time as CSV.
+ *
+ * Example, a complete kids ride:
+ *   carousel_sim --set kids=1@0 --press onoff@1s --press rotate@2s --until 4min
+ *
+ * Example, where the time goes while the carousel is on but idle:
+ *   carousel_sim --press onoff@1s --until 60s --power 8,1.8,0.002
+ *
+ * Example, the rides of an image built with ride_tool:
+ *   carousel_sim --eeprom rides.bin --set kids=1@0 --press onoff@1s ...
+ */
+
+#include "Sim.h"
+#include "SimDevice.h"
+#include "mbed.h"
+
+#include <list>
+#include <string>
+
+int controller_main();
+
+namespace {
+
+// Inputs as wired in main.cpp
+struct Alias {
+  const char *name;
+  PinName pin;
+};
+
+const Alias aliases[] = {
+    {"onoff", PA_1},   {"rotate", PA_6},       {"onoff2", PA_0},
+    {"rotate2", PA_4}, {"onoff3", PA_7},       {"rotate3", PA_8},
+    {"onoff4", PA_9},  {"rotate4", PA_5},      {"emergency", PA_10},
+    {"toddler", PB_0}, {"kids", PB_1},         {"action", PB_2}};
+
+const uint64_t PRESS_TIME = 100000;
+
+class PinChange : public sim::Event {
+public:
+  PinChange(int pin, int level, uint64_t time) : _pin(pin), _level(level) {
+    schedule(time);
+  }
+
+private:
+  void fire() override { sim::setPinLevel(_pin, _level); }
+  int _pin;
+  int _level;
+};
+
+std::list<PinChange> changes;
+
+// Supply current of the controller in mA while running, sleeping and in
+// deep sleep, for the estimate of --power
+double currentRun, currentSleep, currentStop;
+
+void powerReport() {
+  sim::PowerStats p = sim::powerStats();
+  double total = sim::nowNs();
+  double seconds = total / 1e9;
+  fprintf(stderr,
+          "run %.3f%%  interrupts %.3f%%  sleep %.3f%%  deep sleep %.3f%%  "
+          "waking %.3f%%\n",
+          100 * p.runNs / total, 100 * p.interruptNs / total,
+          100 * p.sleepNs / total, 100 * p.deepSleepNs / total,
+          100 * p.wakeupNs / total);
+  fprintf(stderr,
+          "wake-ups %.2f/s, %.2f/s from deep sleep, %.2f/s to a thread\n"
+          "wake latency to the thread mean %.1f us max %.1f us\n",
+          p.wakeups / seconds, p.deepWakeups / seconds,
+          p.taskWakeups / seconds,
+          p.taskWakeups ? p.latencySumNs / 1e3 / p.taskWakeups : 0.0,
+          p.latencyMaxNs / 1e3);
+  double charge = currentRun * (p.runNs + p.interruptNs + p.wakeupNs) +
+                  currentSleep * p.sleepNs + currentStop * p.deepSleepNs;
+  fprintf(stderr, "average current %.4f mA\n", charge / total);
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: carousel_sim [options]\n"
+          "  --until TIME          end of the simulation, default 4min\n"
+          "  --set PIN=LEVEL@TIME  drive an input, LEVEL is 0, 1 or z\n"
+          "  --press PIN@TIME      press a button for 100 ms\n"
+          "  --out FILE            write the recording to FILE\n"
+          "  --eeprom FILE         load the data EEPROM from FILE\n"
+          "  --upload FILE@TIME    send FILE to the serial port\n"
+          "  --power RUN,SLEEP,STOP  print where the time went and the average\n"
+          "                        current from the currents in mA in run,\n"
+          "                        sleep and deep sleep mode. Code takes no\n"
+          "                        virtual time, only waits do, so the run\n"
+          "                        time is a lower bound\n"
+          "  --wakeup TIME         time to leave deep sleep, default 10us\n"
+          "TIME is a number with unit us, ms, s or min. PIN is an mbed pin\n"
+          "name like PA_1 or one of onoff, rotate, emergency, toddler, kids,\n"
+          "action. onoff2, rotate2 ... onoff4, rotate4 are the buttons of the\n"
+          "other carousels, built with CAROUSELS=4.\n");
+  exit(2);
+}
+
+uint64_t parseTime(const std::string &text) {
+  char *unit;
+  double value = strtod(text.c_str(), &unit);
+  std::string u(unit);
+  if (u == "us")
+    return value;
+  if (u == "ms")
+    return value * 1e3;
+  if (u == "s" || (u.empty() && value == 0))
+    return value * 1e6;
+  if (u == "min")
+    return value * 60e6;
+  fprintf(stderr, "bad time '%s'\n", text.c_str());
+  usage();
+  return 0;
+}
+
+int parsePin(const std::string &text) {
+  for (const Alias &alias : aliases) {
+    if (text == alias.name)
+      return alias.pin;
+  }
+  if (text.size() >= 4 && text[0] == 'P' && text[1] >= 'A' &&
+      text[1] <= 'C' && text[2] == '_')
+    return (text[1] - 'A') * 16 + atoi(text.c_str() + 3);
+  fprintf(stderr, "bad pin '%s'\n", text.c_str());
+  usage();
+  return NC;
+}
+
+// PIN@TIME, returns the time and leaves PIN in spec
+uint64_t splitTime(std::string &spec) {
+  size_t at = spec.find('@');
+  if (at == std::string::npos)
+    usage();
+  uint64_t time = parseTime(spec.substr(at + 1));
+  spec.resize(at);
+  return time;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint64_t until = 240000000;
+  sim::setDeepSleepWakeup(10000);
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    std::string value = argv[++i];
+    if (option == "--until") {
+      until = parseTime(value);
+    } else if (option == "--out") {
+      sim::setRecordFile(value);
+    } else if (option == "--set") {
+      uint64_t time = splitTime(value);
+      size_t eq = value.find('=');
+      if (eq == std::string::npos)
+        usage();
+      std::string level = value.substr(eq + 1);
+      changes.emplace_back(parsePin(value.substr(0, eq)),
+                           level == "z" ? -1 : atoi(level.c_str()), time);
+    } else if (option == "--power") {
+      if (sscanf(value.c_str(), "%lf,%lf,%lf", &currentRun, &currentSleep,
+                 &currentStop) != 3)
+        usage();
+      sim::atFinish(&powerReport);
+    } else if (option == "--wakeup") {
+      sim::setDeepSleepWakeup(parseTime(value) * 1000);
+    } else if (option == "--eeprom") {
+      if (!sim::loadEeprom(value)) {
+        perror(value.c_str());
+        exit(1);
+      }
+    } else if (option == "--upload") {
+      uint64_t time = splitTime(value);
+      FILE *file = fopen(value.c_str(), "rb");
+      if (file == NULL) {
+        perror(value.c_str());
+        exit(1);
+      }
+      std::string bytes;
+      int c;
+      while ((c = fgetc(file)) != EOF)
+        bytes += (char)c;
+      fclose(file);
+      sim::serialSend(bytes, time);
+    } else if (option == "--press") {
+      uint64_t time = splitTime(value);
+      int pin = parsePin(value);
+      changes.emplace_back(pin, 1, time);
+      changes.emplace_back(pin, 0, time + PRESS_TIME);
+    } else {
+      usage();
+    }
+  }
+  sim::setEnd(until);
+  controller_main();
+  sim::finish();
+}
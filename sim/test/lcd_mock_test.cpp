@@ -0,0 +1,156 @@
+/* The lcd driver on MockI2C, checked byte by byte.
+ *
+ * Drives lcd_t<MockI2C> and compares what the mock logged with the
+ * PCF8574 bytes the HD44780 needs: D7..D4 in the upper nibble, then
+ * backlight (0x08), E (0x04), RW (0x02) and RS (0x01). Every command and
+ * character is two nibbles, each with E high and then low. Prints the
+ * failed checks and exits with 1 if there are any, so a regression fails
+ * make.
+ *
+ * Example:
+ *   make -C sim test
+ */
+
+#include "LCD.h"
+#include "Sim.h"
+
+#include <unistd.h>
+
+#include <vector>
+
+namespace {
+
+typedef lcd_t<MockI2C> MockLcd;
+
+int failed = 0;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+      failed++;                                                                \
+    }                                                                          \
+  } while (0)
+
+typedef std::vector<uint8_t> Bytes;
+
+// Bytes logged since the last clearLog()
+Bytes logged(MockLcd &display) {
+  const uint8_t *log = display.bus().log();
+  return Bytes(log, log + display.bus().logged());
+}
+
+// A command (rs 0) or character (rs 1) as one transfer of sendeByte or
+// as part of a block of flush
+Bytes nibbles(uint8_t b, uint8_t rs) {
+  uint8_t high = (b & 0xf0) + 0x08 + rs;
+  uint8_t low = ((b & 0x0f) << 4) + 0x08 + rs;
+  return Bytes{high, (uint8_t)(high + 0x04), high,
+               low,  (uint8_t)(low + 0x04),  low};
+}
+
+Bytes block(uint8_t b, uint8_t rs) {
+  uint8_t high = (b & 0xf0) + 0x08 + rs;
+  uint8_t low = ((b & 0x0f) << 4) + 0x08 + rs;
+  return Bytes{(uint8_t)(high + 0x04), high, (uint8_t)(low + 0x04), low};
+}
+
+Bytes operator+(Bytes a, const Bytes &b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+// Address scan, then the 8 bit function set three times and the switch to
+// 4 bit mode as single nibbles, without backlight
+void initialization(MockLcd &display) {
+  Bytes log = logged(display);
+  Bytes start{0x55, 0x30, 0x34, 0x30, 0x30, 0x34, 0x30,
+              0x30, 0x34, 0x30, 0x20, 0x24, 0x20};
+  CHECK(log.size() > start.size());
+  CHECK(Bytes(log.begin(), log.begin() + start.size()) == start);
+  // the mock answers with its latch, which no HD44780 status can be
+  CHECK(!display.busyflag());
+}
+
+// One transfer per row: a control byte when RS changes, the nibbles with E
+// high and low, no filler bytes at 100 kHz
+void blocks(MockLcd &display) {
+  display.asynchron(false);
+  display.bus().clearLog();
+  uint32_t transfers = display.bus().transfers();
+  display.locate(1, 1);
+  display.printf("A");
+  CHECK(display.bus().transfers() - transfers == 1);
+  CHECK(logged(display) == Bytes{0x08} + block(0xc1, 0) + Bytes{0x09} +
+                               block('A', 1));
+  // nothing changed, nothing sent
+  display.bus().clearLog();
+  display.locate(1, 1);
+  display.printf("A");
+  CHECK(logged(display).empty());
+  // the next cell needs no new address
+  display.bus().clearLog();
+  display.printf("B");
+  CHECK(logged(display) == Bytes{0x09} + block('B', 1));
+}
+
+// One transfer per PCF8574 byte as before the blocks
+void bytes(MockLcd &display) {
+  display.blockweise(false);
+  display.bus().clearLog();
+  uint32_t transfers = display.bus().transfers();
+  display.locate(5, 0);
+  display.printf("x");
+  CHECK(logged(display) == nibbles(0x85, 0) + nibbles('x', 1));
+  CHECK(display.bus().transfers() - transfers == 12);
+  display.blockweise(true);
+}
+
+// A custom character goes to its CGRAM address, the next flush sets a
+// DDRAM address again
+void glyph(MockLcd &display) {
+  const uint8_t pattern[8] = {0x1f, 0x1e, 0x1c, 0x18, 0x10, 0x00, 0x01, 0x02};
+  display.bus().clearLog();
+  display.zeichen(2, pattern);
+  Bytes expected = Bytes{0x08} + block(0x50, 0) + Bytes{0x09};
+  for (uint8_t row : pattern)
+    expected = expected + block(row, 1);
+  CHECK(logged(display) == expected);
+  display.bus().clearLog();
+  display.locate(2, 0);
+  display.putc(8 + 2);
+  CHECK(logged(display) == Bytes{0x08} + block(0x82, 0) + Bytes{0x09} +
+                               block(8 + 2, 1));
+}
+
+// Blanking many cells sends the clear command instead
+void clearing(MockLcd &display) {
+  display.locate(0, 0);
+  display.printf("ABCDEFGHIJKLMNOP");
+  display.locate(0, 1);
+  display.printf("abcdefghijklmnop");
+  display.bus().clearLog();
+  display.clear();
+  CHECK(logged(display) == nibbles(0x01, 0));
+  // one character left over is overwritten, not cleared
+  display.locate(0, 0);
+  display.printf("Z");
+  display.bus().clearLog();
+  display.clear();
+  CHECK(logged(display) == Bytes{0x08} + block(0x80, 0) + Bytes{0x09} +
+                               block(' ', 1));
+}
+
+} // namespace
+
+int main() {
+  MockLcd display;
+  initialization(display);
+  blocks(display);
+  bytes(display);
+  glyph(display);
+  clearing(display);
+  printf("lcd on MockI2C: %d checks failed\n", failed);
+  fflush(stdout);
+  _exit(failed ? 1 : 0);
+}
@@ -0,0 +1,103 @@
+/* Stepper coil outputs through BSRR, checked against the per-pin sequences.
+ *
+ * Steps a Stepper on the coils of PortC 0xf00 in wave, full and half step,
+ * clockwise and counter-clockwise, and compares the coil levels after
+ * every step with the sequences the controller wrote pin by pin through
+ * PortOut before the phase tables. Every step must be one BSRR store whose
+ * set and reset halves do not overlap and together cover the four coils,
+ * and the LEDs on the same port must keep their level. Prints the failed
+ * checks and exits with 1 if there are any, so a regression fails make.
+ *
+ * Example:
+ *   make -C sim test
+ */
+
+#include "Delay.h"
+#include "EventScheduler.h"
+#include "GpioOut.h"
+#include "PhaseTable.h"
+#include "Sim.h"
+#include "Stepper.h"
+
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+const uint32_t COILS = 0xf00;
+const uint32_t LEDS = 0x0a5;
+const unsigned STEPS = 20;
+
+int failed = 0;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+      failed++;                                                                \
+    }                                                                          \
+  } while (0)
+
+// Clockwise coil levels as written pin by pin, coil A is PC8
+const uint32_t wave[] = {0x100, 0x200, 0x400, 0x800};
+const uint32_t full[] = {0x300, 0x600, 0xc00, 0x900};
+const uint32_t half[] = {0x100, 0x300, 0x200, 0x600,
+                         0x400, 0xc00, 0x800, 0x900};
+
+GpioOut<PortC, COILS> motor;
+GpioOut<PortC, 0xff> leds;
+EventScheduler steps;
+
+// Run a stepper on the phases and compare every store with the sequence,
+// counter-clockwise runs it backwards from the first phase. The clock moves
+// on in small slices, so every store is seen on its own.
+void check(const char *name, const uint32_t *phases, uint8_t length,
+           const uint32_t *sequence, bool ccw) {
+  leds.write(LEDS);
+  Stepper stepper(steps, motor.bits(), phases, length);
+  stepper.setStepInterval(1ms);
+  uint32_t stores = GPIOC->BSRR.stores();
+  stepper.start();
+  for (unsigned i = 0; i < STEPS; i++) {
+    for (unsigned slice = 0; slice < 20 && GPIOC->BSRR.stores() - stores <= i;
+         slice++)
+      sim::advance(100);
+    uint32_t word = GPIOC->BSRR.last();
+    uint32_t expected = sequence[ccw ? (length - i % length) % length
+                                     : i % length];
+    if ((GPIOC->ODR & COILS) != expected)
+      fprintf(stderr, "%s%s step %u: 0x%x, not 0x%x\n", name,
+              ccw ? " ccw" : "", i, (unsigned)(GPIOC->ODR & COILS),
+              (unsigned)expected);
+    CHECK((GPIOC->ODR & COILS) == expected);
+    CHECK(GPIOC->BSRR.stores() - stores == i + 1);
+    CHECK((word & word >> 16) == 0);
+    CHECK(((word | word >> 16) & 0xffff) == COILS);
+    CHECK((GPIOC->ODR & 0xff) == LEDS);
+  }
+  stepper.stop();
+  CHECK((GPIOC->ODR & COILS) == 0);
+}
+
+template <DriveMode Mode>
+void both(const char *name, const uint32_t *sequence) {
+  typedef PhaseTable<COILS, Mode> Phases;
+  for (uint8_t i = 0; i < Phases::length; i++)
+    CHECK(Phases::cw()[i] == sequence[i]);
+  check(name, Phases::cwSetReset(), Phases::length, sequence, false);
+  check(name, Phases::ccwSetReset(), Phases::length, sequence, true);
+}
+
+} // namespace
+
+int main() {
+  // calibrate now, not in the first step
+  Delay::cycles();
+  both<DRIVE_WAVE>("wave", wave);
+  both<DRIVE_FULL_STEP>("full", full);
+  both<DRIVE_HALF_STEP>("half", half);
+  printf("phases: %d checks failed\n", failed);
+  fflush(stdout);
+  _exit(failed ? 1 : 0);
+}
@@ -0,0 +1,184 @@
+/* rideformat::check on hand built images.
+ *
+ * Builds a valid image of two rides, then breaks one thing at a time and
+ * checks that the image is rejected with the matching error. The CRC is
+ * made to fit again after each change, except for the CRC case, so every
+ * check past it is reached. Prints the failed checks and exits with 1 if
+ * there are any, so a regression fails make.
+ *
+ * Example:
+ *   make -C sim test
+ */
+
+#include "RideFormat.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// MOTOR_STOP of main.cpp
+const uint16_t STOP = 40;
+
+int failed = 0;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+      failed++;                                                                \
+    }                                                                          \
+  } while (0)
+
+// An image under construction, packed by words like the EEPROM holds it
+struct Image {
+  rideformat::Header header;
+  std::vector<rideformat::Entry> entries;
+  std::vector<RideSegment> segments;
+  std::vector<uint8_t> extra; // bytes after the segments
+
+  Image() {
+    header.magic = rideformat::MAGIC;
+    header.version = rideformat::VERSION;
+    entries = {{0, 3}, {3, 2}};
+    segments = {rideSegment(0s, 44, RIDE_JUMP, "Toddler"),
+                rideSegment(0s, 50, RIDE_RAMP),
+                rideSegment(3min, STOP, RIDE_RAMP),
+                rideSegment(0s, 100, RIDE_JUMP, "Kids"),
+                rideSegment(180s, STOP, RIDE_RAMP)};
+  }
+
+  // Header from the contents, with a fitting CRC
+  std::vector<uint32_t> pack() {
+    header.rides = entries.size();
+    header.length = entries.size() * sizeof(rideformat::Entry) +
+                    segments.size() * sizeof(RideSegment) + extra.size();
+    std::vector<uint8_t> body;
+    append(body, entries.data(), entries.size() * sizeof(entries[0]));
+    append(body, segments.data(), segments.size() * sizeof(segments[0]));
+    body.insert(body.end(), extra.begin(), extra.end());
+    header.crc = rideformat::crc32(body.data(), body.size());
+    return words(body);
+  }
+
+  // Header and body in words, so the image is 4 byte aligned
+  std::vector<uint32_t> words(const std::vector<uint8_t> &body) const {
+    std::vector<uint8_t> bytes;
+    append(bytes, &header, sizeof(header));
+    bytes.insert(bytes.end(), body.begin(), body.end());
+    std::vector<uint32_t> image((bytes.size() + 3) / 4);
+    memcpy(image.data(), bytes.data(), bytes.size());
+    return image;
+  }
+
+  static void append(std::vector<uint8_t> &to, const void *data, size_t size) {
+    to.insert(to.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+  }
+};
+
+// Error of check() on the whole image, "" if it is valid
+std::string check(const std::vector<uint32_t> &image, uint32_t size) {
+  const char *error = rideformat::check(image.data(), size, STOP);
+  return error ? error : "";
+}
+
+std::string check(Image &image) {
+  std::vector<uint32_t> words = image.pack();
+  uint32_t size = sizeof(rideformat::Header) + image.header.length;
+  return check(words, size);
+}
+
+// The second ride starts before the first ends, the order only counts
+// within a ride
+void valid() {
+  Image image;
+  CHECK(check(image) == "");
+  std::vector<uint32_t> words = image.pack();
+  CHECK(rideformat::segments(words.data())[3].speed == 100);
+  CHECK(rideformat::entries(words.data())[1].count == 2);
+}
+
+void header() {
+  Image image;
+  std::vector<uint32_t> words = image.pack();
+  CHECK(check(words, sizeof(rideformat::Header) - 1) == "no ride image");
+  image.header.magic = 0x45444950;
+  CHECK(check(image) == "no ride image");
+  image = Image();
+  image.header.version = rideformat::VERSION + 1;
+  CHECK(check(image) == "unknown version");
+  image = Image();
+  image.entries.clear();
+  image.segments.clear();
+  CHECK(check(image) == "no rides");
+}
+
+void lengths() {
+  Image image;
+  std::vector<uint32_t> words = image.pack();
+  uint32_t size = sizeof(rideformat::Header) + image.header.length;
+  CHECK(check(words, size - 1) == "too long");
+  // more than MAX_SIZE, even with the bytes there
+  image.extra.resize(rideformat::MAX_SIZE);
+  CHECK(check(image) == "too long");
+  image.extra.resize(4);
+  CHECK(check(image) == "bad length");
+}
+
+void crc() {
+  Image image;
+  std::vector<uint32_t> words = image.pack();
+  uint32_t size = sizeof(rideformat::Header) + image.header.length;
+  words.back() ^= 0x100;
+  CHECK(check(words, size) == "bad crc");
+}
+
+void segments() {
+  Image image;
+  image.segments[1].ramp = RIDE_RAMP + 1;
+  CHECK(check(image) == "bad segment");
+  image = Image();
+  image.segments[1].reserved = 1;
+  CHECK(check(image) == "bad segment");
+  image = Image();
+  memset(image.segments[0].text, 'x', sizeof(image.segments[0].text));
+  CHECK(check(image) == "bad segment");
+}
+
+void rides() {
+  Image image;
+  image.entries[1].count = 3;
+  CHECK(check(image) == "bad ride");
+  image = Image();
+  image.entries[1].first = 6;
+  image.entries[1].count = 0;
+  CHECK(check(image) == "bad ride");
+  image = Image();
+  image.entries.push_back({5, 0});
+  CHECK(check(image) == "empty ride");
+  image = Image();
+  image.segments[2].speed = 50;
+  CHECK(check(image) == "ride does not stop");
+  image = Image();
+  image.segments[2].offsetMs = 0;
+  image.segments[1].offsetMs = 1000;
+  CHECK(check(image) == "segments out of order");
+}
+
+} // namespace
+
+int main() {
+  valid();
+  header();
+  lengths();
+  crc();
+  segments();
+  rides();
+  printf("ride format: %d checks failed\n", failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/* Host decoder for the trace dumps of the controller.
+ *
+ * Reads a log of the serial port, e.g. captured with a terminal program
+ * after sending 't' or after an emergency stop, finds the dumps in it and
+ * prints every record as a line of the timeline: time since the first
+ * record, time since the previous one, the event and its meaning.
+ *
+ * Example:
+ *   trace_decode serial.log
+ *   trace_decode < serial.log
+ */
+
+#include "RideFormat.h"
+#include "TraceFormat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Names of the controller's enums the records refer to, in their order
+const char *const controls[] = {"on/off", "rotate", "segment", "ramp done",
+                                "emergency"};
+const char *const modes[] = {"off",     "idle",     "ramping",
+                             "running", "stopping", "emergency"};
+const char *const displayOps[] = {"clear", "print", "leds", "animate",
+                                  "glyph"};
+const char *const inputs[] = {"pressed", "released", "held"};
+
+template <size_t N>
+const char *lookup(const char *const (&names)[N], unsigned i) {
+  return i < N ? names[i] : "?";
+}
+
+// What a record means, in words
+void describe(const traceformat::Record &record, char *text, size_t size) {
+  unsigned arg = record.arg;
+  unsigned value = record.value;
+  switch (record.event) {
+  case TRACE_INPUT:
+    snprintf(text, size, "%s 0x%04x", lookup(inputs, arg), value);
+    break;
+  case TRACE_CONTROL:
+    snprintf(text, size, "%s", lookup(controls, arg));
+    break;
+  case TRACE_STATE:
+    snprintf(text, size, "%s -> %s, speed %u", lookup(modes, arg >> 4),
+             lookup(modes, arg & 0xf), value);
+    break;
+  case TRACE_SEGMENT:
+    snprintf(text, size, "%s to %u half steps/s",
+             arg == RIDE_JUMP ? "jump" : "ramp", value);
+    break;
+  case TRACE_SPEED:
+    snprintf(text, size, "%s to index %u", arg ? "jump" : "ramp", value);
+    break;
+  case TRACE_RAMP_DONE:
+    snprintf(text, size, "at index %u", value);
+    break;
+  case TRACE_EMERGENCY:
+    snprintf(text, size, "coils off after %u cycles", value);
+    break;
+  case TRACE_LCD:
+    snprintf(text, size, "%s took %u us", lookup(displayOps, arg), value);
+    break;
+  default:
+    snprintf(text, size, "arg %u value %u", arg, value);
+    break;
+  }
+}
+
+bool parseRecord(const char *line, traceformat::Record &record) {
+  char digits[17];
+  if (sscanf(line, "%16[0-9a-fA-F]", digits) != 1 || strlen(digits) != 16)
+    return false;
+  unsigned long long bits = strtoull(digits, NULL, 16);
+  record.time = bits >> 32;
+  record.event = bits >> 24 & 0xff;
+  record.arg = bits >> 16 & 0xff;
+  record.value = bits & 0xffff;
+  return true;
+}
+
+// Print the records of one dump until its END line. The 32 bit us times
+// wrap after 71 minutes, the signed difference to the previous record
+// unwraps them; records stored by an interrupt a few us out of order show
+// a small negative delta.
+bool decode(FILE *in, int dump) {
+  char line[128];
+  bool first = true;
+  uint32_t previous = 0;
+  long long time = 0;
+  while (fgets(line, sizeof(line), in)) {
+    if (strncmp(line, "END", 3) == 0)
+      return true;
+    traceformat::Record record;
+    if (!parseRecord(line, record)) {
+      fprintf(stderr, "dump %d: skipping \"%.*s\"\n", dump,
+              (int)strcspn(line, "\r\n"), line);
+      continue;
+    }
+    int32_t delta = first ? 0 : (int32_t)(record.time - previous);
+    first = false;
+    previous = record.time;
+    time += delta;
+    char text[64];
+    describe(record, text, sizeof(text));
+    printf("%10.3f ms %+10.3f ms  %-9s  %s\n", time / 1e3, delta / 1e3,
+           traceformat::name(record.event), text);
+  }
+  fprintf(stderr, "dump %d: no END, log cut off\n", dump);
+  return false;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1])) {
+    fprintf(stderr, "usage: trace_decode [LOG]\n");
+    return 2;
+  }
+  FILE *in = stdin;
+  if (argc == 2 && strcmp(argv[1], "-") != 0) {
+    in = fopen(argv[1], "r");
+    if (!in) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+  char line[128];
+  int dumps = 0;
+  while (fgets(line, sizeof(line), in)) {
+    unsigned version;
+    unsigned long records, lost;
+    if (sscanf(line, "TRACE %u %lu %lu", &version, &records, &lost) != 3)
+      continue;
+    if (version != traceformat::VERSION) {
+      fprintf(stderr, "dump %d: version %u, expected %u\n", dumps + 1,
+              version, (unsigned)traceformat::VERSION);
+      return 1;
+    }
+    dumps++;
+    printf("%sdump %d: %lu records, %lu lost before or during it\n",
+           dumps > 1 ? "\n" : "", dumps, records, lost);
+    if (!decode(in, dumps))
+      return 1;
+  }
+  if (!dumps) {
+    fprintf(stderr, "no trace in the log\n");
+    return 1;
+  }
+  return 0;
+}